@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "emulation/c64.h"
+#include "emulation/trap.h"
+
+#include "infrastructure/speed.h"
+#include "infrastructure/perf.h"
+#include "infrastructure/metrics.h"
+
+#include "ui/headless_c64.h"
+
+/* Runs many headless jobs on all cores.
+ *
+ * The machine lives in globals, a worker is thus a process with a
+ * machine of its own. Workers are forked once and take the next job
+ * from a counter in shared memory until there are none left, each
+ * job runs from the state the machine powered on in. The ROMs are
+ * mapped and the parsed jobs inherited, read only and shared. Every
+ * job writes only its own slot of results, printed in job order
+ * when all are done. A worker that crashes loses only the job it
+ * ran, another one is forked for the jobs left. */
+
+#define MAX_LINE 4096
+
+enum status {
+    status_pending,
+    status_running,
+    status_ok,
+    status_failed
+};
+
+struct job {
+    /* Line in the job file */
+    int                     line;
+    struct headless_options options;
+};
+
+struct result {
+    enum status             status;
+    int                     worker;
+    double                  seconds;
+    struct headless_results results;
+};
+
+struct shared {
+    /* Next job to take */
+    uint32_t      next;
+    struct result results[];
+};
+
+static struct job    *_jobs;
+static uint32_t      _num_jobs;
+static struct shared *_shared;
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options] <job file>\n"
+           "  -j <num>    Workers, default one per core\n"
+           "  -r <dir>    Directory with ROM images\n"
+           "  -B <file>   Cache state at READY in file\n"
+           "  -d <dir>    Directory served as device 8\n"
+           "  -n <trap>   Turn off KERNAL trap, 'all' for every trap\n"
+           "  -o <file>   Write results to file, default stdout\n"
+           "  -v          Show what workers print\n"
+           "A job is a line of key=value pairs:\n"
+           "  prg=<file> input=<file> frames=<num> cycles=<num>\n"
+           "  pc=<addr> screenshot=<file> ram=<file> trace=<file>\n"
+           "  metrics=<file> exact=1\n"
+           "Jobs stop at frames, cycles, PC or the end of the input log,\n"
+           "whatever comes first. A trapped ROM routine may run past\n"
+           "frames and cycles, unless exact.\n",
+           name);
+}
+
+/* Values point into line, which is kept */
+static bool parse_job(char *line, int number, struct job *job)
+{
+    struct headless_options *options = &job->options;
+    char                    *token;
+    char                    *value;
+
+    memset(job, 0, sizeof(*job));
+    job->line               = number;
+    options->metrics_period = 50;
+
+    for (token = strtok(line, " \t\n"); token; token = strtok(NULL, " \t\n")) {
+        value = strchr(token, '=');
+        if (!value) {
+            printf("Line %d: expected key=value, got %s\n", number, token);
+            return false;
+        }
+        *value++ = '\0';
+        if (strcmp(token, "prg") == 0) {
+            options->prg = value;
+        }
+        else if (strcmp(token, "input") == 0) {
+            options->replay = value;
+        }
+        else if (strcmp(token, "frames") == 0) {
+            options->frames = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "cycles") == 0) {
+            options->cycles = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(token, "pc") == 0) {
+            options->break_on_pc = true;
+            options->break_pc    = strtol(value, NULL, 16);
+        }
+        else if (strcmp(token, "screenshot") == 0) {
+            options->screenshot = value;
+        }
+        else if (strcmp(token, "ram") == 0) {
+            options->ram_dump = value;
+        }
+        else if (strcmp(token, "trace") == 0) {
+            options->trace = value;
+        }
+        else if (strcmp(token, "metrics") == 0) {
+            options->metrics_dump = value;
+        }
+        else if (strcmp(token, "exact") == 0) {
+            options->exact = strtol(value, NULL, 10) != 0;
+        }
+        else {
+            printf("Line %d: unknown key %s\n", number, token);
+            return false;
+        }
+    }
+    if (!options->frames && !options->cycles && !options->break_on_pc &&
+        !options->replay) {
+        printf("Line %d: nothing to stop at\n", number);
+        return false;
+    }
+    return true;
+}
+
+static bool read_jobs(const char *path)
+{
+    FILE     *f = fopen(path, "r");
+    char     buf[MAX_LINE];
+    char     *line;
+    char     *start;
+    int      number = 0;
+    uint32_t size   = 0;
+    bool     ok     = true;
+
+    if (!f) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    while (ok && fgets(buf, sizeof(buf), f)) {
+        number++;
+        start = buf + strspn(buf, " \t\n");
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+        if (_num_jobs == size) {
+            size  = size ? size * 2 : 64;
+            _jobs = realloc(_jobs, size * sizeof(*_jobs));
+        }
+        line = strdup(start);
+        ok   = _jobs && line &&
+               parse_job(line, number, &_jobs[_num_jobs++]);
+    }
+    fclose(f);
+    return ok;
+}
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Takes jobs until there are none left */
+static void work(int worker, const char *boot_cache,
+                 const struct c64_saved_state *power_on)
+{
+    struct headless_options options;
+    struct result           *result;
+    uint32_t                index;
+    double                  start;
+
+    for (;;) {
+        index = __atomic_fetch_add(&_shared->next, 1, __ATOMIC_RELAXED);
+        if (index >= _num_jobs) {
+            return;
+        }
+        result         = &_shared->results[index];
+        result->worker = worker;
+        result->status = status_running;
+
+        /* Settings a job may have changed, an input log sets run
+         * ahead. Lines not drawn yet when a job stops are left from
+         * the job before, unless cleared. */
+        c64_restore_state(power_on);
+        c64_set_idle_skip(true);
+        c64_set_loop_acceleration(true);
+        c64_set_run_ahead(0);
+        trap_set_acceleration(true);
+        metrics_reset();
+        memset(c64_framebuffer(), 0, C64_SCREEN_WIDTH * C64_SCREEN_HEIGHT *
+               sizeof(uint32_t));
+
+        options            = _jobs[index].options;
+        options.boot_cache = boot_cache;
+        start              = now();
+        result->status     = headless_c64_run(&options,
+                                              &result->results) == 0 ?
+                             status_ok : status_failed;
+        result->seconds    = now() - start;
+        fflush(stdout);
+    }
+}
+
+static pid_t start_worker(int worker, const char *boot_cache,
+                          const struct c64_saved_state *power_on)
+{
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        work(worker, boot_cache, power_on);
+        _exit(0);
+    }
+    return pid;
+}
+
+/* As a JSON string, quotes and control characters escaped */
+static void write_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(f, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+        }
+        else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void write_results(FILE *f)
+{
+    const struct result *result;
+    const struct job    *job;
+    const char          *status;
+    uint32_t            i;
+
+    for (i = 0; i < _num_jobs; i++) {
+        result = &_shared->results[i];
+        job    = &_jobs[i];
+        switch (result->status) {
+        case status_ok:
+            status = "ok";
+            break;
+        case status_failed:
+            status = "failed";
+            break;
+        case status_running:
+            status = "crashed";
+            break;
+        default:
+            status = "not run";
+            break;
+        }
+        fprintf(f, "{\"job\":%u,\"line\":%d,\"prg\":", i, job->line);
+        write_string(f, job->options.prg ? job->options.prg : "");
+        fprintf(f, ",\"status\":\"%s\"", status);
+        if (result->status == status_ok ||
+            result->status == status_failed) {
+            fprintf(f, ",\"worker\":%d,\"seconds\":%.3f,"
+                    "\"frames\":%llu,\"cycles\":%llu,"
+                    "\"instructions\":%llu,\"pc\":%u,\"mhz\":%.3f",
+                    result->worker, result->seconds,
+                    (unsigned long long)result->results.frames,
+                    (unsigned long long)result->results.cycles,
+                    (unsigned long long)result->results.instructions,
+                    result->results.pc, result->results.speed.mhz);
+        }
+        fprintf(f, "}\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct c64_saved_state *power_on;
+    const char             *rom_dir     = NULL;
+    const char             *boot_cache  = NULL;
+    const char             *drive_dir   = NULL;
+    const char             *output      = NULL;
+    const char             *traps_off[16];
+    int                    num_traps_off = 0;
+    int                    num_workers   = sysconf(_SC_NPROCESSORS_ONLN);
+    int                    running       = 0;
+    int                    next_worker   = 0;
+    bool                   verbose       = false;
+    int                    results_fd;
+    double                 start;
+    FILE                   *f;
+    pid_t                  pid;
+    int                    status;
+    int                    opt;
+    int                    i;
+
+    while ((opt = getopt(argc, argv, "j:r:B:d:n:o:vh")) != -1) {
+        switch (opt) {
+        case 'j':
+            num_workers = strtol(optarg, NULL, 10);
+            break;
+        case 'r':
+            rom_dir = optarg;
+            break;
+        case 'B':
+            boot_cache = optarg;
+            break;
+        case 'd':
+            drive_dir = optarg;
+            break;
+        case 'n':
+            if (num_traps_off < 16) {
+                traps_off[num_traps_off++] = optarg;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return -1;
+    }
+    if (!read_jobs(argv[optind])) {
+        return -1;
+    }
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+
+    /* Results go where stdout went, workers and the machine print
+     * progress there. */
+    results_fd = dup(STDOUT_FILENO);
+    if (!verbose) {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    /* Workers inherit the machine as it powered on */
+    if (c64_init(rom_dir) != 0) {
+        fprintf(stderr, "Failed to power on, -v shows why\n");
+        return -1;
+    }
+    if (drive_dir) {
+        trap_set_directory(drive_dir);
+    }
+    for (i = 0; i < num_traps_off; i++) {
+        if (!trap_enable(traps_off[i], false)) {
+            fprintf(stderr, "No trap named %s\n", traps_off[i]);
+            return -1;
+        }
+    }
+    speed_init(C64_CLOCK_HZ);
+    perf_init();
+    power_on = malloc(sizeof(*power_on));
+    if (!power_on) {
+        return -1;
+    }
+    c64_save_state(power_on);
+
+    _shared = mmap(NULL, sizeof(*_shared) +
+                   _num_jobs * sizeof(_shared->results[0]),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                   -1, 0);
+    if (_shared == MAP_FAILED) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    fflush(stdout);
+
+    start = now();
+    for (i = 0; i < num_workers && (uint32_t)i < _num_jobs; i++) {
+        if (start_worker(next_worker++, boot_cache, power_on) > 0) {
+            running++;
+        }
+    }
+    while (running && (pid = wait(&status)) > 0) {
+        running--;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+        /* Crashed, the job it ran is lost but not the rest */
+        if (__atomic_load_n(&_shared->next, __ATOMIC_RELAXED) < _num_jobs &&
+            start_worker(next_worker++, boot_cache, power_on) > 0) {
+            running++;
+        }
+    }
+    fprintf(stderr, "%u jobs in %.2f s on %d workers\n",
+            _num_jobs, now() - start, num_workers);
+
+    f = output ? fopen(output, "w") : fdopen(results_fd, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", output);
+        return -1;
+    }
+    write_results(f);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "c64.h"
+#include "cpu.h"
+#include "boot.h"
+#include "savestate.h"
+
+/* Give up when READY has not been reached in this many cycles */
+#define MAX_BOOT_CYCLES 20000000
+
+static bool restore(const char *path)
+{
+    if (access(path, R_OK) != 0) {
+        return false;
+    }
+    /* Saved with other ROMs or another version of the format */
+    if (!savestate_restore(path)) {
+        printf("Ignoring stale boot cache %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+int boot_to_ready(const char *cache_path)
+{
+    struct cpu_state state;
+    int              ret = 0;
+
+    if (cache_path && restore(cache_path)) {
+        printf("Restored boot state from %s\n", cache_path);
+        return 0;
+    }
+
+    cpu_get_state(&state);
+    while (state.pc != BOOT_READY_PC) {
+        if (c64_cycles() >= MAX_BOOT_CYCLES) {
+            printf("BASIC not ready after %d cycles\n", MAX_BOOT_CYCLES);
+            ret = -1;
+            break;
+        }
+        c64_step();
+        cpu_get_state(&state);
+    }
+
+    if (cache_path && ret == 0 && !savestate_save(cache_path)) {
+        printf("Failed to write boot cache %s\n", cache_path);
+    }
+    return ret;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/* Brings the machine from power on to the BASIC READY prompt.
+ *
+ * Booting takes more than a million cycles that are the same every
+ * time for a given set of ROMs. The state at READY is cached in a
+ * file keyed by the ROM checksum, following boots restore it instead
+ * of running the KERNAL reset sequence. */
+
+/* PC of BASIC main loop, reached when READY has been printed */
+#define BOOT_READY_PC 0xa480
+
+/* Runs until READY unless cache_path holds a state saved with the
+ * same ROMs, in which case that state is restored. cache_path is
+ * (re)written after a cold boot. No caching when NULL. */
+int boot_to_ready(const char *cache_path);
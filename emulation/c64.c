@@ -1,5 +1,11 @@
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -13,58 +19,232 @@
 #include "emulation/sid.h"
 #include "emulation/cpu_port.h"
 #include "emulation/pla.h"
+#include "emulation/c64.h"
+#include "emulation/rom.h"
+#include "emulation/trap.h"
+#include "emulation/coverage.h"
+#include "emulation/rewind.h"
+#include "emulation/input.h"
+#include "infrastructure/trace.h"
+#include "infrastructure/perf.h"
+#include "infrastructure/metrics.h"
 
-/* ROMs */
-static uint8_t _basic_rom[8192];
-static uint8_t _kernal_rom[8192];
-static uint8_t _chargen_rom[4096];
+/* Directory to load ROMs from when none is specified */
+#ifndef C64_ROM_PATH
+#define C64_ROM_PATH "../rom"
+#endif
+
+/* VIC is stepped twice for each step of the machine */
+#define CYCLES_PER_STEP 2
+
+/* ROMs, read only and shared by all instances */
+static const uint8_t *_basic_rom;
+static const uint8_t *_kernal_rom;
+static const uint8_t *_chargen_rom;
+/* Directory the ROMs are mapped from, empty when embedded or none */
+static char          _rom_dir[1024];
 
 static struct cpu_state _cpu_state;
 
 static int _vic_skips = 0;
 static bool _stall_cpu = false;
+static bool _idle_skip = false;
+static bool _loop_acceleration = false;
+/* Settings to go back to when coverage is turned off */
+static bool _coverage_idle_skip;
+static bool _coverage_loop_acceleration;
+
+/* Emulated time */
+static uint64_t _cycles = 0;
+static uint64_t _frames = 0;
+/* Frames completed during the current step, a trapped routine like
+ * RAMTAS completes many */
+static int      _frames_complete;
+
+/* Frames run ahead of the machine and the state to go back to */
+static int                    _run_ahead;
+static bool                   _running_ahead;
+static struct c64_saved_state *_run_ahead_state;
+
+/* Cycle of the next replayed input */
+static uint64_t _input_due = UINT64_MAX;
+
+/* Frames executed again without idle skipping and loop acceleration
+ * from the state they started with, see c64_set_shadow() */
+static bool                   _shadow;
+static bool                   _shadowing;
+static bool                   _shadow_differs;
+static bool                   _shadow_started;
+static struct c64_saved_state *_shadow_start;
+static struct c64_saved_state *_shadow_fast;
+static struct c64_saved_state *_shadow_reference;
+
+static c64_refresh_hook _refresh_hook;
+
+/* Rendered to when no front end provides a screen */
+static uint32_t *_framebuffer;
 
-static bool load_rom(const char *path,
-                     uint8_t *rom_out, uint16_t size)
+/* Maps ROM image read only, the page cache is shared between all
+ * processes running the same image. */
+static const uint8_t* load_rom(const char *dir, const char *name,
+                               size_t size)
 {
-    FILE *f = fopen(path, "rb");
-    uint16_t read;
+    char        path[1024];
+    struct stat st;
+    void        *rom;
+    int         fd;
 
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
     printf("Loading ROM: %s\n", path);
 
-    if (f != NULL) {
-        read = fread(rom_out, 1, size, f);
-        if (read != size) {
-            printf("Failed to read all bytes, got %d\n", read);
-            return false;
-        }
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        printf("Failed to read rom at %s\n", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)size) {
+        printf("Expected %zu bytes in %s\n", size, path);
+        close(fd);
+        return NULL;
+    }
+    rom = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rom == MAP_FAILED) {
+        printf("Failed to map rom at %s\n", path);
+        return NULL;
+    }
+    return rom;
+}
+
+static void unload_rom(const uint8_t *rom, size_t size)
+{
+    if (rom) {
+        munmap((void *)rom, size);
+    }
+}
+
+static void unload_roms()
+{
+    if (_rom_dir[0]) {
+        unload_rom(_basic_rom, ROM_BASIC_SIZE);
+        unload_rom(_kernal_rom, ROM_KERNAL_SIZE);
+        unload_rom(_chargen_rom, ROM_CHARGEN_SIZE);
+        _rom_dir[0] = '\0';
+    }
+}
+
+/* Mappings are kept when loaded from the same directory again. When
+ * one fails to load the ROMs in use are kept as well. */
+static bool load_roms(const char *dir)
+{
+    const uint8_t *basic;
+    const uint8_t *kernal;
+    const uint8_t *chargen;
+
+#ifdef C64_EMBEDDED_ROMS
+    if (!dir) {
+        unload_roms();
+        _basic_rom   = rom_basic;
+        _kernal_rom  = rom_kernal;
+        _chargen_rom = rom_chargen;
         return true;
     }
-    else
-        printf("Failed to read rom at %s\n", path);
+#endif
+    if (!dir) {
+        dir = C64_ROM_PATH;
+    }
+    if (_rom_dir[0] && strcmp(_rom_dir, dir) == 0) {
+        return true;
+    }
+    basic   = load_rom(dir, "basic_v2.bin", ROM_BASIC_SIZE);
+    kernal  = load_rom(dir, "kernal_rev3.bin", ROM_KERNAL_SIZE);
+    chargen = load_rom(dir, "chargen.bin", ROM_CHARGEN_SIZE);
+    if (!basic || !kernal || !chargen) {
+        unload_rom(basic, ROM_BASIC_SIZE);
+        unload_rom(kernal, ROM_KERNAL_SIZE);
+        unload_rom(chargen, ROM_CHARGEN_SIZE);
+        return false;
+    }
 
-    return false;
+    unload_roms();
+    _basic_rom   = basic;
+    _kernal_rom  = kernal;
+    _chargen_rom = chargen;
+    snprintf(_rom_dir, sizeof(_rom_dir), "%s", dir);
+    return true;
+}
+
+static void present_frame()
+{
+    enum perf_subsystem from = perf_switch(perf_frontend);
+
+    metrics_frame();
+    if (_refresh_hook) {
+        _refresh_hook();
+    }
+    perf_frame();
+    perf_switch(from);
+}
+
+static void on_refresh()
+{
+    _frames++;
+    _frames_complete++;
+    /* Front end is shown the frame ahead once it has been run, and
+     * a frame executed again not at all */
+    if (!_running_ahead && !_run_ahead && !_shadowing) {
+        present_frame();
+    }
+}
+
+/* Binary trace records when and where events happen */
+static void trace_context_of(struct trace_record *record)
+{
+    struct cpu_state state;
+
+    cpu_get_state(&state);
+    record->cycle = _cycles;
+    record->pc    = state.pc;
+    record->reg_a = state.reg_a;
+    record->reg_x = state.reg_x;
+    record->reg_y = state.reg_y;
+    record->flags = state.flags;
+    record->sp    = state.sp;
 }
 
 int c64_init(const char *rom_path)
 {
-    if (!load_rom("../rom/basic_v2.bin", _basic_rom, 8192) ||
-        !load_rom("../rom/kernal_rev3.bin", _kernal_rom, 8192) ||
-        !load_rom("../rom/chargen.bin", _chargen_rom, 4096)) {
+    if (!load_roms(rom_path)) {
         return -1;
     }
 
+    metrics_init();
     mem_init();
     pla_init(_kernal_rom, _basic_rom, _chargen_rom);
     keyboard_init();
     sid_init();
     cpu_port_init();
     cpu_init(mem_get_for_cpu, mem_set_for_cpu);
+    cpu_set_peek(mem_peek_for_cpu);
+    trap_init();
+    c64_set_idle_skip(true);
+    c64_set_loop_acceleration(true);
+    trace_set_context(trace_context_of);
     cia1_init();
     cia2_init();
     vic_init(_chargen_rom,
              mem_get_ram(0),
              mem_get_color_ram_for_vic());
+    vic_set_refresh_hook(on_refresh);
+
+    if (!_framebuffer) {
+        _framebuffer = calloc(C64_SCREEN_WIDTH * C64_SCREEN_HEIGHT,
+                              sizeof(*_framebuffer));
+        if (!_framebuffer) {
+            return -1;
+        }
+    }
+    c64_screen_default();
 
     mem_reset();
     cia1_reset();
@@ -81,9 +261,143 @@ void c64_reset()
 {
 }
 
-void c64_step()
+void c64_set_refresh_hook(c64_refresh_hook hook)
+{
+    _refresh_hook = hook;
+}
+
+void c64_screen_default()
 {
+    vic_screen(_framebuffer, C64_SCREEN_WIDTH * sizeof(*_framebuffer));
+}
+
+uint32_t* c64_framebuffer()
+{
+    return _framebuffer;
+}
+
+/* FNV-1a a pixel at a time */
+uint64_t c64_framebuffer_hash()
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t   i;
+
+    for (i = 0; i < C64_SCREEN_WIDTH * C64_SCREEN_HEIGHT; i++) {
+        hash ^= _framebuffer[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int c64_load_prg(const char *path, uint16_t *start, uint16_t *size)
+{
+    FILE    *f;
+    size_t  read;
+    uint8_t buf[0x10001];
+
+    f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    read = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (read <= 2) {
+        return -1;
+    }
+
+    /* Two first bytes is load address */
+    *start = (buf[1] << 8) | buf[0];
+    *size  = read - 2;
+    if (*start + *size > 0x10000) {
+        *size = 0x10000 - *start;
+    }
+    memcpy(mem_get_ram(*start), buf + 2, *size);
+    mem_set_dirty(*start, *size);
+    return 0;
+}
+
+uint64_t c64_cycles()
+{
+    return _cycles;
+}
+
+uint64_t c64_frames()
+{
+    return _frames;
+}
+
+void c64_save_state(struct c64_saved_state *saved)
+{
+    cpu_save_state(&saved->cpu);
+    mem_save_state(&saved->mem);
+    cia1_save_state(&saved->cia1);
+    cia2_save_state(&saved->cia2);
+    vic_save_state(&saved->vic);
+    pla_save_state(&saved->pla);
+    cpu_port_save_state(&saved->cpu_port);
+    keyboard_save_state(&saved->keyboard);
+
+    saved->vic_skips = _vic_skips;
+    saved->stall_cpu = _stall_cpu;
+    saved->cycles    = _cycles;
+    saved->frames    = _frames;
+}
+
+void c64_restore_state(const struct c64_saved_state *saved)
+{
+    cpu_restore_state(&saved->cpu);
+    mem_restore_state(&saved->mem);
+    cia1_restore_state(&saved->cia1);
+    cia2_restore_state(&saved->cia2);
+    vic_restore_state(&saved->vic);
+    cpu_port_restore_state(&saved->cpu_port);
+    /* Reinstalls memory hooks, needs the other devices restored */
+    pla_restore_state(&saved->pla);
+    keyboard_restore_state(&saved->keyboard);
+
+    _vic_skips = saved->vic_skips;
+    _stall_cpu = saved->stall_cpu;
+    _cycles    = saved->cycles;
+    _frames    = saved->frames;
+    _cpu_state = saved->cpu.state;
+
+    /* The frame did not start from here */
+    if (!_shadowing) {
+        _shadow_started = false;
+    }
+}
+
+/* FNV-1a */
+static uint32_t checksum(uint32_t hash, const uint8_t *data, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t c64_rom_checksum()
+{
+    uint32_t hash = 2166136261u;
+
+    hash = checksum(hash, _basic_rom, ROM_BASIC_SIZE);
+    hash = checksum(hash, _kernal_rom, ROM_KERNAL_SIZE);
+    hash = checksum(hash, _chargen_rom, ROM_CHARGEN_SIZE);
+    return hash;
+}
+
+/* Steps everything but the CPU, returns false if the VIC stalled
+ * the CPU during the step. */
+static inline bool step_devices()
+{
+    _cycles += CYCLES_PER_STEP;
+    metrics.cycles += CYCLES_PER_STEP;
+    perf_switch(perf_cia);
     cia1_cycle();
+    perf_switch(perf_vic);
     if (_vic_skips) {
         _vic_skips--;
     }
@@ -96,10 +410,489 @@ void c64_step()
     else {
         vic_step(&_vic_skips, &_stall_cpu);
     }
-    if (!_stall_cpu) {
-        cpu_step(&_cpu_state);
+    perf_switch(perf_cpu);
+    if (_stall_cpu) {
+        _stall_cpu = false;
+        return false;
+    }
+    return true;
+}
+
+static void step_cpu()
+{
+    int executed = cpu_step(&_cpu_state);
+
+    /* A trapped routine executed more than one instruction, catch up
+     * with the steps the CPU would have spent on them. */
+    while (executed > 1) {
+        if (step_devices()) {
+            executed--;
+        }
+    }
+}
+
+/* True when any polled register differs from values */
+static inline bool polled_changed(const uint16_t *polled,
+                                  const uint8_t *values,
+                                  int num_polled)
+{
+    int i;
+
+    for (i = 0; i < num_polled; i++) {
+        if (mem_peek_for_cpu(polled[i]) != values[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The CPU spins in a loop that cannot end before an interrupt or
+ * before a polled register like the raster line changes. Steps the
+ * devices only, counting the instructions the CPU would have
+ * executed, until the frame is complete or the loop ends. When a
+ * polled register changes, the loop is probed again from where the
+ * CPU would be with the new value, a wait for a certain raster line
+ * is thus skipped over all the lines before it. */
+static void skip_idle_loop(const uint16_t *polled, int num_polled)
+{
+    uint64_t frames  = _frames;
+    uint64_t skipped = 0;
+    uint16_t addresses[CPU_IDLE_LOOP_MAX_POLLED];
+    uint8_t  values[CPU_IDLE_LOOP_MAX_POLLED];
+    bool     cpu_slot;
+    int      i;
+
+    memcpy(addresses, polled, sizeof(addresses));
+    for (i = 0; i < num_polled; i++) {
+        values[i] = mem_peek_for_cpu(addresses[i]);
+    }
+
+    while (_frames == frames) {
+        cpu_slot = step_devices();
+        if (polled_changed(addresses, values, num_polled)) {
+            cpu_run_idle(skipped);
+            skipped = 0;
+            if (!cpu_idle_resume(addresses, &num_polled)) {
+                if (cpu_slot) {
+                    step_cpu();
+                }
+                else {
+                    cpu_get_state(&_cpu_state);
+                }
+                return;
+            }
+            for (i = 0; i < num_polled; i++) {
+                values[i] = mem_peek_for_cpu(addresses[i]);
+            }
+        }
+        if (!cpu_slot) {
+            continue;
+        }
+        if (cpu_irq_pending()) {
+            cpu_run_idle(skipped);
+            step_cpu();
+            return;
+        }
+        skipped++;
+    }
+    cpu_run_idle(skipped);
+    cpu_get_state(&_cpu_state);
+}
+
+/* Runs the machine frames ahead with the current input, draws only
+ * the last of them and goes back. Counters only count the frames
+ * that are kept. */
+static void run_ahead()
+{
+    struct metrics counted = metrics;
+    int            i;
+
+    c64_save_state(_run_ahead_state);
+    _running_ahead = true;
+    for (i = 0; i < _run_ahead; i++) {
+        vic_set_render(i == _run_ahead - 1);
+        _frames_complete = 0;
+        while (!_frames_complete) {
+            c64_step();
+        }
+    }
+    vic_set_render(false);
+    _running_ahead   = false;
+    _frames_complete = 0;
+    c64_restore_state(_run_ahead_state);
+    metrics = counted;
+}
+
+/* A step of the machine, without what happens between steps */
+static void step()
+{
+    uint16_t polled[CPU_IDLE_LOOP_MAX_POLLED];
+    int      num_polled;
+    int      idle_length;
+
+    if (!step_devices()) {
+        return;
+    }
+    step_cpu();
+
+    if (_idle_skip) {
+        idle_length = cpu_idle_loop(polled, &num_polled);
+        if (idle_length) {
+            skip_idle_loop(polled, num_polled);
+        }
+    }
+}
+
+/* Steps to cycle, applying input on the way but not at cycle */
+static void run_reference(uint64_t cycle)
+{
+    while (_cycles < cycle) {
+        step();
+        if (_cycles < cycle && _cycles >= _input_due) {
+            _input_due = input_apply();
+        }
+    }
+}
+
+/* Prints what differs when print, false when nothing */
+static bool differs(const struct c64_saved_state *fast,
+                    const struct c64_saved_state *reference, bool print)
+{
+    const struct cpu_state *f = &fast->cpu.state;
+    const struct cpu_state *r = &reference->cpu.state;
+    const struct {
+        const char *name;
+        size_t     offset;
+        size_t     size;
+    } devices[] = {
+        { "Color RAM", offsetof(struct c64_saved_state, mem.color_ram),
+          sizeof(fast->mem.color_ram) },
+        { "CIA 1", offsetof(struct c64_saved_state, cia1),
+          sizeof(fast->cia1) },
+        { "CIA 2", offsetof(struct c64_saved_state, cia2),
+          sizeof(fast->cia2) },
+        { "VIC", offsetof(struct c64_saved_state, vic),
+          sizeof(fast->vic) },
+        { "PLA", offsetof(struct c64_saved_state, pla),
+          sizeof(fast->pla) },
+        { "CPU port", offsetof(struct c64_saved_state, cpu_port),
+          sizeof(fast->cpu_port) },
+        { "Keyboard", offsetof(struct c64_saved_state, keyboard),
+          sizeof(fast->keyboard) },
+    };
+    bool     found = false;
+    uint32_t num   = 0;
+    uint32_t first = 0;
+    uint32_t i;
+
+    if (f->pc != r->pc || f->reg_a != r->reg_a || f->reg_x != r->reg_x ||
+        f->reg_y != r->reg_y || f->flags != r->flags || f->sp != r->sp ||
+        f->instructions != r->instructions ||
+        fast->cpu.irq_pending != reference->cpu.irq_pending) {
+        found = true;
+        if (print) {
+            printf("CPU        PC    A  X  Y  SP P  IRQ instructions\n");
+            printf("fast       %04x  %02x %02x %02x %02x %02x %d   %llu\n",
+                   f->pc, f->reg_a, f->reg_x, f->reg_y, f->sp, f->flags,
+                   fast->cpu.irq_pending,
+                   (unsigned long long)f->instructions);
+            printf("reference  %04x  %02x %02x %02x %02x %02x %d   %llu\n",
+                   r->pc, r->reg_a, r->reg_x, r->reg_y, r->sp, r->flags,
+                   reference->cpu.irq_pending,
+                   (unsigned long long)r->instructions);
+        }
+    }
+    for (i = 0; i < sizeof(fast->mem.ram); i++) {
+        if (fast->mem.ram[i] != reference->mem.ram[i]) {
+            first = num ? first : i;
+            num++;
+        }
+    }
+    if (num) {
+        found = true;
+        if (print) {
+            printf("RAM differs in %u bytes, first $%04x fast %02x "
+                   "reference %02x\n", num, first, fast->mem.ram[first],
+                   reference->mem.ram[first]);
+        }
+    }
+    for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        if (memcmp((const uint8_t *)fast + devices[i].offset,
+                   (const uint8_t *)reference + devices[i].offset,
+                   devices[i].size) != 0) {
+            found = true;
+            if (print) {
+                printf("%s differs\n", devices[i].name);
+            }
+        }
+    }
+    if (fast->vic_skips != reference->vic_skips ||
+        fast->stall_cpu != reference->stall_cpu ||
+        fast->cycles != reference->cycles ||
+        fast->frames != reference->frames) {
+        found = true;
+        if (print) {
+            printf("Cycles fast %llu reference %llu\n",
+                   (unsigned long long)fast->cycles,
+                   (unsigned long long)reference->cycles);
+        }
+    }
+    return found;
+}
+
+/* The frame differs, executes it again from the start step by step
+ * until the step that makes the difference and leaves the machine
+ * before it. */
+static void find_difference(uint64_t end, bool idle_skip,
+                            bool loop_acceleration)
+{
+    struct c64_saved_state *before = _shadow_start;
+    uint16_t               next;
+    bool                   found   = false;
+
+    printf("Shadow execution differs in frame %llu\n",
+           (unsigned long long)before->frames);
+    differs(_shadow_fast, _shadow_reference, true);
+
+    c64_restore_state(before);
+    input_rerun(_cycles);
+    while (_cycles < end) {
+        c64_save_state(before);
+        c64_set_idle_skip(idle_skip);
+        c64_set_loop_acceleration(loop_acceleration);
+        step();
+        c64_save_state(_shadow_fast);
+
+        c64_restore_state(before);
+        c64_set_idle_skip(false);
+        c64_set_loop_acceleration(false);
+        run_reference(_shadow_fast->cycles);
+        c64_save_state(_shadow_reference);
+        if (differs(_shadow_fast, _shadow_reference, false)) {
+            printf("First in the step from instruction %llu at cycle "
+                   "%llu\n",
+                   (unsigned long long)before->cpu.state.instructions,
+                   (unsigned long long)before->cycles);
+            fflush(stdout);
+            cpu_disassembly_at(STDOUT_FILENO, before->cpu.state.pc, 1,
+                               &next);
+            differs(_shadow_fast, _shadow_reference, true);
+            c64_restore_state(before);
+            found = true;
+            break;
+        }
+        if (_cycles >= _input_due) {
+            _input_due = input_apply();
+        }
+    }
+    if (!found) {
+        printf("Not in any step on its own, stopped at the end of the "
+               "frame\n");
+    }
+    input_rerun_end();
+    /* The log goes on from where the machine no longer is */
+    if (input_is_replaying()) {
+        input_stop();
+    }
+}
+
+/* Executes the frame just completed again from where it started,
+ * each instruction its own step, and compares. */
+static void shadow_frame()
+{
+    struct metrics counted           = metrics;
+    bool           idle_skip         = _idle_skip;
+    bool           loop_acceleration = _loop_acceleration;
+    uint64_t       input_due         = _input_due;
+
+    /* Nothing to compare against, or input missing to do it again */
+    if (!_shadow_started || (!idle_skip && !loop_acceleration) ||
+        _shadow_start->cycles >= _cycles ||
+        _shadow_start->cycles <= input_kept_since()) {
+        return;
+    }
+
+    _shadowing = true;
+    c64_save_state(_shadow_fast);
+    c64_restore_state(_shadow_start);
+    input_rerun(_cycles);
+    c64_set_idle_skip(false);
+    c64_set_loop_acceleration(false);
+    run_reference(_shadow_fast->cycles);
+    c64_save_state(_shadow_reference);
+
+    if (differs(_shadow_fast, _shadow_reference, false)) {
+        find_difference(_shadow_fast->cycles, idle_skip,
+                        loop_acceleration);
+        _shadow         = false;
+        _shadow_differs = true;
     }
     else {
-        _stall_cpu = false;
+        input_rerun_done();
+        _input_due = input_due;
+    }
+    c64_set_idle_skip(idle_skip);
+    c64_set_loop_acceleration(loop_acceleration);
+    _shadowing       = false;
+    _frames_complete = 0;
+    metrics          = counted;
+}
+
+/* The machine is consistent between steps only, state is saved for
+ * rewinding and running ahead then, and input arrives. */
+static inline void end_step()
+{
+    int dropped;
+
+    perf_switch(perf_other);
+    if (_running_ahead) {
+        return;
+    }
+    if (_frames_complete) {
+        dropped          = _frames_complete - 1;
+        _frames_complete = 0;
+        if (_shadow) {
+            shadow_frame();
+        }
+        rewind_frame();
+        if (_run_ahead) {
+            /* There is no state between frames completed in the same
+             * step to run ahead from, only the last is shown */
+            metrics.frames         += dropped;
+            metrics.frames_skipped += dropped;
+            run_ahead();
+            present_frame();
+        }
+        /* Where the next frame is executed again from */
+        if (_shadow) {
+            c64_save_state(_shadow_start);
+            _shadow_started = true;
+        }
+    }
+    /* After the front end would have seen the frame, like input
+     * from it */
+    if (_cycles >= _input_due) {
+        _input_due = input_apply();
+    }
+}
+
+void c64_step()
+{
+    step();
+    end_step();
+}
+
+/* RAM, ROM and color RAM are stable, writes only where reading back
+ * gives what was written. Reading VIC registers has no side effects,
+ * the raster line changes by itself. */
+static enum cpu_mem_kind classify(uint16_t addr, bool write)
+{
+    if (addr >= 0xd000 && addr < 0xe000 && pla_is_io_mapped()) {
+        if (addr < 0xd400 && !write) {
+            return cpu_mem_polled;
+        }
+        if (addr >= 0xd800 && addr < 0xdc00) {
+            return cpu_mem_stable;
+        }
+        return cpu_mem_volatile;
+    }
+    if (write && !(addr < 0xa000 || (addr >= 0xc000 && addr < 0xd000))) {
+        return cpu_mem_volatile;
+    }
+    return cpu_mem_stable;
+}
+
+void c64_set_idle_skip(bool enable)
+{
+    _idle_skip = enable;
+    cpu_set_idle_detection(enable ? classify : NULL);
+}
+
+bool c64_is_idle_skip()
+{
+    return _idle_skip;
+}
+
+void c64_set_loop_acceleration(bool enable)
+{
+    _loop_acceleration = enable;
+    cpu_set_loop_acceleration(enable ? mem_get_page_for_cpu : NULL);
+}
+
+bool c64_is_loop_acceleration()
+{
+    return _loop_acceleration;
+}
+
+bool c64_set_run_ahead(int frames)
+{
+    if (frames && !_run_ahead_state) {
+        _run_ahead_state = calloc(1, sizeof(*_run_ahead_state));
+        if (!_run_ahead_state) {
+            return false;
+        }
+    }
+    _run_ahead = frames;
+    /* Frames kept are never shown */
+    vic_set_render(!frames);
+    return true;
+}
+
+int c64_get_run_ahead()
+{
+    return _run_ahead;
+}
+
+void c64_set_input_due(uint64_t cycle)
+{
+    _input_due = cycle;
+}
+
+bool c64_set_shadow(bool enable)
+{
+    if (enable && !_shadow_start) {
+        _shadow_start     = calloc(1, sizeof(*_shadow_start));
+        _shadow_fast      = calloc(1, sizeof(*_shadow_fast));
+        _shadow_reference = calloc(1, sizeof(*_shadow_reference));
+        if (!_shadow_start || !_shadow_fast || !_shadow_reference) {
+            return false;
+        }
+    }
+    _shadow         = enable;
+    _shadow_started = false;
+    _shadow_differs = false;
+    return true;
+}
+
+bool c64_is_shadow()
+{
+    return _shadow;
+}
+
+bool c64_shadow_differs()
+{
+    return _shadow_differs;
+}
+
+bool c64_set_coverage(bool enable)
+{
+    if (enable == coverage_is_enabled()) {
+        return true;
+    }
+    if (!coverage_enable(enable)) {
+        return false;
+    }
+    if (enable) {
+        _coverage_idle_skip         = _idle_skip;
+        _coverage_loop_acceleration = _loop_acceleration;
+        c64_set_idle_skip(false);
+        c64_set_loop_acceleration(false);
+        cpu_set_fetch(mem_fetch_for_cpu);
+    }
+    else {
+        c64_set_idle_skip(_coverage_idle_skip);
+        c64_set_loop_acceleration(_coverage_loop_acceleration);
+        cpu_set_fetch(NULL);
     }
+    return true;
 }
@@ -1,5 +1,118 @@
+#pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 
+#include "cpu.h"
+#include "mem.h"
+#include "cia.h"
+#include "vic.h"
+#include "pla.h"
+#include "cpu_port.h"
+#include "keyboard.h"
+
+/* PAL system clock */
+#define C64_CLOCK_HZ 985248
+
+/* Size of screen the VIC renders to */
+#define C64_SCREEN_WIDTH  400
+#define C64_SCREEN_HEIGHT 400
+
+typedef void (*c64_refresh_hook)();
+
+/* Loads ROMs from rom_path directory. When NULL, ROMs linked into
+ * the executable are used if built with them, otherwise ROMs are
+ * loaded from the rom directory of the source tree. */
 int c64_init(const char *rom_path);
 void c64_reset();
 void c64_step();
+
+/* Called when the VIC has completed a frame */
+void c64_set_refresh_hook(c64_refresh_hook hook);
+
+/* VIC renders to a framebuffer owned by the machine unless a
+ * front end has handed it another screen. */
+void c64_screen_default();
+uint32_t* c64_framebuffer();
+/* Fast, not cryptographic, hash of what the framebuffer shows */
+uint64_t c64_framebuffer_hash();
+
+/* Loads a PRG file to RAM at the address in the file */
+int c64_load_prg(const char *path, uint16_t *start, uint16_t *size);
+
+/* When the CPU spins in a loop that can only be left through an
+ * interrupt or a change of raster line, the rest of the machine is
+ * stepped without it until then or the end of the frame. Emulated
+ * time is exact, but c64_step() may then run up to a frame. On by
+ * default. */
+void c64_set_idle_skip(bool enable);
+bool c64_is_idle_skip();
+
+/* Copy and fill loops over RAM run with interrupts disabled are
+ * executed natively, see cpu_set_loop_acceleration(). On by
+ * default. */
+void c64_set_loop_acceleration(bool enable);
+bool c64_is_loop_acceleration();
+
+/* Hides the latency from input to screen of the running program.
+ * After every frame, the machine runs frames ahead with the current
+ * input, the front end is shown the last of them and the machine
+ * goes back. The frames kept are not drawn. A step completes more
+ * than a frame only in a trapped routine like RAMTAS at power on,
+ * of those frames only the last is shown and the rest are counted
+ * as skipped. Host side effects of traps, like files written by
+ * SAVE, happen for frames run ahead as well. 0 to turn off, false
+ * when out of memory. */
+bool c64_set_run_ahead(int frames);
+int c64_get_run_ahead();
+
+/* Calls input_apply() between steps once emulated time reaches
+ * cycle, UINT64_MAX for never. */
+void c64_set_input_due(uint64_t cycle);
+
+/* Validates idle skipping and loop acceleration. After every frame
+ * the machine goes back to where the frame started and executes it
+ * again without either, with the input that arrived meanwhile, and
+ * compares where it gets to. On the first difference, the step that
+ * made it is found and printed together with what differs, and the
+ * machine is left before that step with this turned off. Frames
+ * with the state replaced or input missing are not validated. Traps
+ * run twice, with their host side effects. False when out of
+ * memory. */
+bool c64_set_shadow(bool enable);
+bool c64_is_shadow();
+/* A difference was found since turned on */
+bool c64_shadow_differs();
+
+/* Collects memory coverage, see coverage.h. Idle loops are not
+ * skipped and loops are not accelerated meanwhile, every access is
+ * then seen. False when out of memory. */
+bool c64_set_coverage(bool enable);
+
+/* Emulated time since init */
+uint64_t c64_cycles();
+uint64_t c64_frames();
+
+/* Complete machine state, ROMs excluded */
+struct c64_saved_state {
+    struct cpu_saved_state      cpu;
+    struct mem_saved_state      mem;
+    struct cia_saved_state      cia1;
+    struct cia_saved_state      cia2;
+    struct vic_saved_state      vic;
+    struct pla_saved_state      pla;
+    struct cpu_port_saved_state cpu_port;
+    struct keyboard_saved_state keyboard;
+
+    int      vic_skips;
+    bool     stall_cpu;
+    uint64_t cycles;
+    uint64_t frames;
+};
+
+void c64_save_state(struct c64_saved_state *saved);
+void c64_restore_state(const struct c64_saved_state *saved);
+
+/* Identifies the ROMs in use, state saved with one set of
+ * ROMs is meaningless with another. */
+uint32_t c64_rom_checksum();
@@ -209,3 +209,40 @@ uint8_t cia_get_register(struct cia_state *state,
 }
 
 
+
+void cia_save_state(const struct cia_state *state,
+                    struct cia_saved_state *saved)
+{
+    saved->interrupt_data        = state->interrupt_data;
+    saved->interrupt_mask        = state->interrupt_mask;
+    saved->data_direction_port_A = state->data_direction_port_A;
+    saved->data_direction_port_B = state->data_direction_port_B;
+    saved->data_port_A           = state->data_port_A;
+    saved->data_port_B           = state->data_port_B;
+    saved->timer_A               = state->timer_A;
+    saved->timer_A.trace         = NULL;
+    saved->timer_A_raw           = state->timer_A_raw;
+    saved->timer_B               = state->timer_B;
+    saved->timer_B.trace         = NULL;
+    saved->timer_B_raw           = state->timer_B_raw;
+}
+
+void cia_restore_state(struct cia_state *state,
+                       const struct cia_saved_state *saved)
+{
+    struct trace_point *trace_A = state->timer_A.trace;
+    struct trace_point *trace_B = state->timer_B.trace;
+
+    state->interrupt_data        = saved->interrupt_data;
+    state->interrupt_mask        = saved->interrupt_mask;
+    state->data_direction_port_A = saved->data_direction_port_A;
+    state->data_direction_port_B = saved->data_direction_port_B;
+    state->data_port_A           = saved->data_port_A;
+    state->data_port_B           = saved->data_port_B;
+    state->timer_A               = saved->timer_A;
+    state->timer_A.trace         = trace_A;
+    state->timer_A_raw           = saved->timer_A_raw;
+    state->timer_B               = saved->timer_B;
+    state->timer_B.trace         = trace_B;
+    state->timer_B_raw           = saved->timer_B_raw;
+}
@@ -77,8 +77,29 @@ struct cia_state {
     struct trace_point *trace_error;
 };
 
+/* Registers and timers for save states, callbacks and trace
+ * points stay with the live state. */
+struct cia_saved_state {
+    uint8_t interrupt_data;
+    uint8_t interrupt_mask;
+    uint8_t data_direction_port_A;
+    uint8_t data_direction_port_B;
+    uint8_t data_port_A;
+    uint8_t data_port_B;
+
+    struct cia_timer timer_A;
+    uint8_t          timer_A_raw;
+    struct cia_timer timer_B;
+    uint8_t          timer_B_raw;
+};
+
 void cia_reset(struct cia_state *state);
 
+void cia_save_state(const struct cia_state *state,
+                    struct cia_saved_state *saved);
+void cia_restore_state(struct cia_state *state,
+                       const struct cia_saved_state *saved);
+
 void cia_cycle(struct cia_state *state);
 
 void cia_set_register(struct cia_state *state,
@@ -40,6 +40,16 @@ void cia1_cycle()
     cia_cycle(&_state);
 }
 
+void cia1_save_state(struct cia_saved_state *saved)
+{
+    cia_save_state(&_state, saved);
+}
+
+void cia1_restore_state(const struct cia_saved_state *saved)
+{
+    cia_restore_state(&_state, saved);
+}
+
 uint8_t cia1_reg_get(uint16_t absolute, uint8_t *ram)
 {
     /* Registers are mirrored at each 16 bytes */
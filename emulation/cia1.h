@@ -9,6 +9,9 @@ void cia1_init();
 void cia1_reset(); /* RES pin low */
 void cia1_cycle();
 
+void cia1_save_state(struct cia_saved_state *saved);
+void cia1_restore_state(const struct cia_saved_state *saved);
+
 /* PLA maps address space */
 uint8_t cia1_reg_get(uint16_t absolute, uint8_t *ram);
 
@@ -2,6 +2,7 @@
 #include <stdint.h>
 
 #include "mem.h"
+#include "cia.h"
 
 #define CIA2_ADDRESS 0xdd00
 
@@ -9,6 +10,9 @@ void cia2_init();
 void cia2_reset();
 void cia2_cycle();
 
+void cia2_save_state(struct cia_saved_state *saved);
+void cia2_restore_state(const struct cia_saved_state *saved);
+
 uint8_t cia2_reg_get(uint16_t absolute, uint8_t *ram);
 
 void cia2_reg_set(uint8_t val, uint16_t absolute, uint8_t *ram);
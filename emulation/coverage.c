@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coverage.h"
+
+static const char *_kind_names[coverage_num_kinds] = {
+    [coverage_cpu_fetch]    = "CPU fetch",
+    [coverage_cpu_read]     = "CPU read",
+    [coverage_cpu_write]    = "CPU write",
+    [coverage_vic_badline]  = "VIC bad line",
+    [coverage_vic_graphics] = "VIC graphics",
+};
+
+bool            coverage_enabled;
+struct coverage *coverage_data;
+
+void coverage_record_slow(enum coverage_kind kind, uint16_t address)
+{
+    uint32_t *counter;
+
+    coverage_data->pages[address >> 8][kind]++;
+    if (kind >= COVERAGE_ADDRESS_KINDS) {
+        return;
+    }
+    coverage_data->bitmaps[kind][address >> 3] |= 1 << (address & 7);
+    counter = &coverage_data->counters[kind][address];
+    if (*counter != UINT32_MAX) {
+        (*counter)++;
+    }
+}
+
+bool coverage_enable(bool enable)
+{
+    if (enable && !coverage_data) {
+        coverage_data = calloc(1, sizeof(*coverage_data));
+        if (!coverage_data) {
+            return false;
+        }
+    }
+    coverage_enabled = enable;
+    return true;
+}
+
+bool coverage_is_enabled()
+{
+    return coverage_enabled;
+}
+
+void coverage_reset()
+{
+    if (coverage_data) {
+        memset(coverage_data, 0, sizeof(*coverage_data));
+    }
+}
+
+const struct coverage *coverage_get()
+{
+    return coverage_data;
+}
+
+/* Number of bits needed for count, a rough logarithm */
+static uint32_t bits(uint32_t count)
+{
+    return count ? 32 - __builtin_clz(count) : 0;
+}
+
+/* 0 - 255 on a logarithmic scale up to max bits */
+static uint32_t intensity(uint32_t count, uint32_t max_bits)
+{
+    if (!count) {
+        return 0;
+    }
+    /* Touched at all is always visible */
+    return 64 + 191 * bits(count) / max_bits;
+}
+
+void coverage_heatmap(uint32_t pixels[256 * 256])
+{
+    uint32_t max_bits[COVERAGE_ADDRESS_KINDS];
+    uint32_t max;
+    int      kind;
+    int      i;
+
+    memset(pixels, 0, 256 * 256 * sizeof(pixels[0]));
+    if (!coverage_data) {
+        return;
+    }
+    for (kind = 0; kind < COVERAGE_ADDRESS_KINDS; kind++) {
+        max = 0;
+        for (i = 0; i < 65536; i++) {
+            if (coverage_data->counters[kind][i] > max) {
+                max = coverage_data->counters[kind][i];
+            }
+        }
+        max_bits[kind] = bits(max);
+    }
+    for (i = 0; i < 65536; i++) {
+        pixels[i] =
+            intensity(coverage_data->counters[coverage_cpu_write][i],
+                      max_bits[coverage_cpu_write]) << 16 |
+            intensity(coverage_data->counters[coverage_cpu_fetch][i],
+                      max_bits[coverage_cpu_fetch]) << 8 |
+            intensity(coverage_data->counters[coverage_cpu_read][i],
+                      max_bits[coverage_cpu_read]);
+    }
+}
+
+bool coverage_save_raw(const char *path)
+{
+    FILE   *f;
+    size_t written;
+
+    if (!coverage_data) {
+        return false;
+    }
+    f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+    written = fwrite(coverage_data, sizeof(*coverage_data), 1, f);
+    fclose(f);
+    return written == 1;
+}
+
+static int count_bits(const uint8_t *bitmap)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < 65536 / 8; i++) {
+        count += __builtin_popcount(bitmap[i]);
+    }
+    return count;
+}
+
+void coverage_stat()
+{
+    uint64_t hottest;
+    int      page;
+    int      kind;
+    int      i;
+
+    printf("Coverage       : %s\n", coverage_enabled ? "on" : "off");
+    if (!coverage_data) {
+        return;
+    }
+    printf("Bytes fetched  : %d\n",
+           count_bits(coverage_data->bitmaps[coverage_cpu_fetch]));
+    printf("Bytes read     : %d\n",
+           count_bits(coverage_data->bitmaps[coverage_cpu_read]));
+    printf("Bytes written  : %d\n",
+           count_bits(coverage_data->bitmaps[coverage_cpu_write]));
+
+    printf("Hottest page per access\n");
+    for (kind = 0; kind < coverage_num_kinds; kind++) {
+        hottest = 0;
+        page    = 0;
+        for (i = 0; i < 256; i++) {
+            if (coverage_data->pages[i][kind] > hottest) {
+                hottest = coverage_data->pages[i][kind];
+                page    = i;
+            }
+        }
+        if (hottest) {
+            printf("%-14s : $%02x00 %llu\n", _kind_names[kind], page,
+                   (unsigned long long)hottest);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Which addresses are executed, read and written, and which pages
+ * the CPU and the VIC access.
+ *
+ * Per address there is a bitmap and a saturating counter for bytes
+ * fetched as instructions, read as data and written by the CPU. Per
+ * page there are counters for every kind of access, the VIC ones by
+ * the RAM address it read, or for the character ROM by where the ROM
+ * appears in its bank.
+ *
+ * Off until enabled, until then the memory paths only check a flag. */
+
+enum coverage_kind {
+    /* Opcode and operand bytes */
+    coverage_cpu_fetch,
+    coverage_cpu_read,
+    coverage_cpu_write,
+    /* Video matrix fetched on bad lines */
+    coverage_vic_badline,
+    /* Character and bitmap data */
+    coverage_vic_graphics,
+    coverage_num_kinds
+};
+
+/* Only the CPU kinds are kept per address */
+#define COVERAGE_ADDRESS_KINDS 3
+
+struct coverage {
+    uint8_t  bitmaps[COVERAGE_ADDRESS_KINDS][65536 / 8];
+    uint32_t counters[COVERAGE_ADDRESS_KINDS][65536];
+    uint64_t pages[256][coverage_num_kinds];
+};
+
+extern bool            coverage_enabled;
+extern struct coverage *coverage_data;
+
+void coverage_record_slow(enum coverage_kind kind, uint16_t address);
+
+static inline void coverage_record(enum coverage_kind kind,
+                                   uint16_t address)
+{
+    if (__builtin_expect(coverage_enabled, 0)) {
+        coverage_record_slow(kind, address);
+    }
+}
+
+/* False when out of memory. Data is kept when turned off. */
+bool coverage_enable(bool enable);
+bool coverage_is_enabled();
+void coverage_reset();
+
+/* NULL before first enabled */
+const struct coverage *coverage_get();
+
+/* 256x256 pixels, one per address with a row per page. Red is
+ * written, green executed and blue read, brighter the more often on
+ * a logarithmic scale. */
+void coverage_heatmap(uint32_t pixels[256 * 256]);
+
+/* Writes struct coverage as is */
+bool coverage_save_raw(const char *path);
+
+void coverage_stat();
@@ -5,21 +5,38 @@
 #include <string.h>
 
 #include "trace.h"
+#include "metrics.h"
 #include "cpu_ops.h"
 #include "cpu.h"
 #include "cpu_instr.h"
+#include "cpu_calls.h"
 
 
 /* Needed for cycle calculation and edge behaviours */
 #define PAGE_SIZE           0x100
 
+/* Times a backward jump is taken before looking for an idle loop */
+#define IDLE_LOOP_ITERATIONS 4
+/* Longest idle loop in instructions */
+#define IDLE_LOOP_MAX        16
+/* Longest way into an idle loop and around it */
+#define IDLE_PATH_MAX        (2 * IDLE_LOOP_MAX)
+/* Iterations before looking at a loop that was not idle again */
+#define IDLE_LOOP_BACKOFF    256
+
+/* Longest copy or fill loop body in bytes and accesses */
+#define COPY_LOOP_BYTES      20
+#define COPY_LOOP_ACCESSES   8
+
 /* CPU hardwired addresses */
 #define ADDR_STACK_START    0x0100
 #define ADDR_IRQ_VECTOR     0xfffe
 
 /* Memory access */
 static cpu_mem_get _mem_get;
+static cpu_mem_get _mem_fetch;
 static cpu_mem_set _mem_set;
+static cpu_mem_set _mem_set_default;
 
 /* Actual registers and status */
 static struct cpu_state _state;
@@ -27,10 +44,42 @@ static struct cpu_state _state;
 /* Interrupt handling */
 static bool _irq_pending;
 
+/* One bit per address, set when handler should be called before
+ * executing the instruction there. */
+static uint8_t          _trapped[65536 / 8];
+static cpu_trap_handler _trap_handler;
+
+/* Idle loop detection, disabled when NULL */
+static cpu_mem_classify  _classify;
+static uint16_t          _loop_start;
+static uint16_t          _loop_end;
+static int               _loop_count;
+static int               _loop_backoff;
+static int               _idle_length;
+static uint16_t          _idle_polled[CPU_IDLE_LOOP_MAX_POLLED];
+static int               _idle_num_polled;
+
+/* State before each instruction of an idle loop, the first
+ * _idle_entry lead into the loop made up of the rest. */
+static struct cpu_state  _idle_path[IDLE_PATH_MAX];
+static int               _idle_path_length;
+static int               _idle_entry;
+
+/* Copy and fill loops executed natively, disabled when NULL */
+static cpu_mem_page      _loop_page;
+
+/* One loop iteration is probed with memory access redirected */
+static bool        _probe_pure;
+static cpu_mem_get _probe_mem_get;
+static cpu_mem_get _mem_peek;
+
 /* For debugging */
 static bool               _stack_overflow;
 static bool               _stack_underflow;
-static struct cpu_state   _state_before;
+/* Profiling */
+static struct cpu_profile_entry *_profile;
+static bool                     _call_graph;
+
 static struct trace_point *_trace_execution;
 static struct trace_point *_trace_interrupt;
 static struct trace_point *_trace_error;
@@ -110,126 +159,109 @@ static inline void set_flag(struct cpu_state *state, uint8_t flag)
     state->flags |= flag;
 }
 
-static void trace_register(int fd, char name,
-                           uint8_t val0, uint8_t val1)
-{
-    char trace[10];
-
-    if (val0 != val1) {
-        sprintf(trace, " %c=$%02x ", name, val1);
-        write(fd, trace, 6);
-    }
-}
-
-static void trace_flags(int fd, uint8_t s)
+static int format_flags(char *text, uint8_t s)
 {
-    char trace[8];
-
-    trace[7] = s & FLAG_CARRY        ? 'C' : ' ';
-    trace[6] = s & FLAG_ZERO         ? 'Z' : ' ';
-    trace[5] = s & FLAG_IRQ_DISABLE  ? 'I' : ' ';
-    trace[4] = s & FLAG_DECIMAL_MODE ? 'D' : ' ';
-    trace[3] = s & FLAG_BRK          ? 'B' : ' ';
-    trace[2] = ' '; /* Unused */
-    trace[1] = s & FLAG_OVERFLOW     ? 'V' : ' ';
-    trace[0] = s & FLAG_NEGATIVE     ? 'N' : ' ';
-    write(fd, trace, 8);
+    text[7] = s & FLAG_CARRY        ? 'C' : ' ';
+    text[6] = s & FLAG_ZERO         ? 'Z' : ' ';
+    text[5] = s & FLAG_IRQ_DISABLE  ? 'I' : ' ';
+    text[4] = s & FLAG_DECIMAL_MODE ? 'D' : ' ';
+    text[3] = s & FLAG_BRK          ? 'B' : ' ';
+    text[2] = ' '; /* Unused */
+    text[1] = s & FLAG_OVERFLOW     ? 'V' : ' ';
+    text[0] = s & FLAG_NEGATIVE     ? 'N' : ' ';
+    text[8] = 0;
+    return 8;
 }
 
-static void trace_instruction(int fd,
-                              uint16_t address,
-                              struct instruction *instr,
-                              int pad)
+static void format_operands(char *text, const struct instruction *instr)
 {
-    char    trace[20];
-    uint8_t ops_len = 0;
-
-    sprintf(trace, "$%04x %s ",
-            address,
-            mnemonics_strings[instr->operation->mnem]);
-    write(fd, trace, strlen(trace));
-    trace[0] = 0;
-
-    write(fd, instr->operation->undocumented ? "*" : " ", 1);
+    text[0] = 0;
 
     switch (instr->operation->mode) {
     case Absolute:
-        sprintf(trace, "$%02x%02x",
+        sprintf(text, "$%02x%02x",
                 instr->operands[1], instr->operands[0]);
         break;
     case Absolute_X:
-        sprintf(trace, "$%02x%02x,X",
+        sprintf(text, "$%02x%02x,X",
                 instr->operands[1], instr->operands[0]);
         break;
     case Absolute_Y:
-        sprintf(trace, "$%02x%02x,Y",
+        sprintf(text, "$%02x%02x,Y",
                 instr->operands[1], instr->operands[0]);
         break;
     case Accumulator:
-        sprintf(trace, "A");
+        sprintf(text, "A");
         break;
     case Immediate:
-        sprintf(trace, "#$%02x", instr->operands[0]);
+        sprintf(text, "#$%02x", instr->operands[0]);
         break;
     case Implied:
         break;
     case Indirect:
-        sprintf(trace, "($%02x%02x)",
+        sprintf(text, "($%02x%02x)",
                 instr->operands[1], instr->operands[0]);
         break;
     case Indirect_X:
-        sprintf(trace, "($%02x,X)",
+        sprintf(text, "($%02x,X)",
                 instr->operands[0]);
         break;
     case Indirect_Y:
-        sprintf(trace, "($%02x),Y",
+        sprintf(text, "($%02x),Y",
                 instr->operands[0]);
         break;
     case Relative:
         if (instr->operands[0] & 0x80) {
-            sprintf(trace, "-$%02x", (0x100 - instr->operands[0]));
+            sprintf(text, "-$%02x", (0x100 - instr->operands[0]));
         } else {
-            sprintf(trace, "+$%02x", instr->operands[0] + 2);
+            sprintf(text, "+$%02x", instr->operands[0] + 2);
         }
         break;
     case Zeropage:
-        sprintf(trace, "$%02x", instr->operands[0]);
+        sprintf(text, "$%02x", instr->operands[0]);
         break;
     case Zeropage_X:
-        sprintf(trace, "$%02x, X", instr->operands[0]);
+        sprintf(text, "$%02x, X", instr->operands[0]);
         break;
     case Zeropage_Y:
-        sprintf(trace, "$%02x, Y", instr->operands[0]);
+        sprintf(text, "$%02x, Y", instr->operands[0]);
         break;
     default:
-        trace[0] = '?';
-        trace[1] = 0;
+        text[0] = '?';
+        text[1] = 0;
         break;
     }
-    ops_len = strlen(trace);
-    write(fd, trace, ops_len);
-    while (ops_len < pad) {
-        write(fd, " ", 1);
-        ops_len++;
-    }
+}
+
+/* Address, mnemonic and operands padded to pad characters */
+static int format_instruction(char *text, size_t size,
+                              uint16_t address,
+                              const struct instruction *instr,
+                              int pad)
+{
+    char operands[20];
+
+    format_operands(operands, instr);
+    return snprintf(text, size, "$%04x %s %s%-*s",
+                    address,
+                    mnemonics_strings[instr->operation->mnem],
+                    instr->operation->undocumented ? "*" : " ",
+                    pad, operands);
 }
 
 static void trace_execution(int fd, struct instruction *instr,
                             struct cpu_state *s0,
                             struct cpu_state *s1)
 {
-    if (fd < 0)
-        return;
-
-    trace_instruction(fd, s0->pc, instr, 10);
-    trace_flags(fd, s1->flags);
-
-    trace_register(fd, 'A', s0->reg_a, s1->reg_a);
-    trace_register(fd, 'X', s0->reg_x, s1->reg_x);
-    trace_register(fd, 'Y', s0->reg_y, s1->reg_y);
-    trace_register(fd, 'S', s0->sp, s1->sp);
-
-    write(fd, "\n", 1);
+    uint8_t bytes[3];
+    char    line[80];
+    int     len;
+
+    bytes[0] = instr->operation - opcodes;
+    bytes[1] = instr->operands[0];
+    bytes[2] = instr->operands[1];
+    len = cpu_trace_line(line, sizeof(line), bytes, s0, s1);
+    write(fd, line, len);
 }
 
 static void interrupt_request()
@@ -246,6 +278,7 @@ static void interrupt_request()
     /* Retrieve handler at cpu hardwired address */
     read_address(ADDR_IRQ_VECTOR, &handler_address);
     TRACE(_trace_interrupt, "IRQ handled by %04x", handler_address);
+    metrics.irqs_taken++;
     /* Point program counter to IRQ handler routine */
     _state.pc = handler_address;
 }
@@ -375,7 +408,7 @@ static void xor(struct instruction *instr)
 static void asl(struct instruction *instr)
 {
     uint8_t  operand;
-    uint16_t address;
+    uint16_t address = 0;
     uint8_t  shifted;
 
     if (instr->operation->mode == Accumulator) {
@@ -400,7 +433,7 @@ static void lsr( struct instruction *instr)
 {
     uint8_t operand;
     uint8_t shifted;
-    uint16_t address;
+    uint16_t address = 0;
 
     if (instr->operation->mode == Accumulator) {
         operand = _state.reg_a;
@@ -424,7 +457,7 @@ static void rol(
                 struct instruction *instr)
 {
     uint8_t  operand;
-    uint16_t address;
+    uint16_t address = 0;
     uint8_t  shifted;
 
     if (instr->operation->mode == Accumulator) {
@@ -448,7 +481,7 @@ static void rol(
 static void ror(struct instruction *instr)
 {
     uint8_t  operand;
-    uint16_t address;
+    uint16_t address = 0;
     uint8_t  shifted;
 
     if (instr->operation->mode == Accumulator) {
@@ -854,10 +887,6 @@ static int execute(struct instruction *instr)
               mnemonics_strings[instr->operation->mnem]);
     }
 
-    /* Writes instruction and registers to debug fd */
-    trace_execution(_trace_execution->fd, instr,
-                    &_state_before, &_state);
-
     return 0;
 }
 
@@ -898,7 +927,7 @@ static int fetch_and_decode(struct instruction *instr)
     int          num_operands;
     uint8_t      *operands = instr->operands;
 
-    op_code = _mem_get(_state.pc++);
+    op_code = _mem_fetch(_state.pc++);
     instr->operation = &opcodes[op_code];
 
     num_operands = get_num_operands(instr->operation->mode);
@@ -906,11 +935,11 @@ static int fetch_and_decode(struct instruction *instr)
     case 0:
         break;
     case 1:
-        operands[0] = _mem_get(_state.pc++);
+        operands[0] = _mem_fetch(_state.pc++);
         break;
     case 2:
-        operands[0] = _mem_get(_state.pc++);
-        operands[1] = _mem_get(_state.pc++);
+        operands[0] = _mem_fetch(_state.pc++);
+        operands[1] = _mem_fetch(_state.pc++);
         break;
     default:
         TRACE(_trace_error,
@@ -922,11 +951,66 @@ static int fetch_and_decode(struct instruction *instr)
     return 0;
 }
 
+/* Executes the instruction at PC and writes it with the registers
+ * to the execution trace, kept apart so execute() pays nothing for
+ * tracing. */
+static void execute_traced(struct instruction *instr)
+{
+    struct cpu_state       before = _state;
+    struct trace_record    *record;
+    struct trace_execution *execution;
+
+    fetch_and_decode(instr);
+    execute(instr);
+
+    if (_trace_execution->fd != TRACE_FD_BINARY) {
+        trace_execution(_trace_execution->fd, instr, &before, &_state);
+        return;
+    }
+    record = trace_record_begin(_trace_execution, trace_record_execution);
+    if (!record) {
+        return;
+    }
+    record->pc    = before.pc;
+    record->reg_a = before.reg_a;
+    record->reg_x = before.reg_x;
+    record->reg_y = before.reg_y;
+    record->flags = before.flags;
+    record->sp    = before.sp;
+    record->size  = sizeof(*execution);
+
+    execution = (struct trace_execution*)record->payload;
+    execution->bytes[0] = instr->operation - opcodes;
+    execution->bytes[1] = instr->operands[0];
+    execution->bytes[2] = instr->operands[1];
+    execution->reg_a    = _state.reg_a;
+    execution->reg_x    = _state.reg_x;
+    execution->reg_y    = _state.reg_y;
+    execution->flags    = _state.flags;
+    execution->sp       = _state.sp;
+    trace_record_commit();
+}
+
+/* Cycles of an instruction go to the routine executing it, a JSR
+ * enters a routine after it and any instruction popping the return
+ * address of a routine leaves it. */
+static void track_calls(const struct instruction *instr)
+{
+    cpu_calls_cycles(instr->operation->cycles);
+    cpu_calls_leave(_state.sp);
+    if (instr->operation->mnem == JSR) {
+        cpu_calls_enter(_state.pc, _state.sp + 2, false);
+    }
+}
+
 void cpu_init(cpu_mem_get mem_get,
               cpu_mem_set mem_set)
 {
-    _mem_get = mem_get;
-    _mem_set = mem_set;
+    _mem_get         = mem_get;
+    _mem_set         = mem_set;
+    _mem_set_default = mem_set;
+    _mem_fetch       = mem_get;
+    _mem_peek        = mem_get;
     cpu_reset();
 
     /* Debugging */
@@ -950,6 +1034,23 @@ void cpu_set_state(struct cpu_state *state)
     _state = *state;
 }
 
+void cpu_get_state(struct cpu_state *state)
+{
+    *state = _state;
+}
+
+void cpu_save_state(struct cpu_saved_state *saved)
+{
+    saved->state       = _state;
+    saved->irq_pending = _irq_pending;
+}
+
+void cpu_restore_state(const struct cpu_saved_state *saved)
+{
+    _state       = saved->state;
+    _irq_pending = saved->irq_pending;
+}
+
 void cpu_interrupt_request()
 {
     if (!(_state.flags & FLAG_IRQ_DISABLE)) {
@@ -958,27 +1059,551 @@ void cpu_interrupt_request()
     }
     else {
         TRACE0(_trace_interrupt, "IRQ denied");
+        metrics.irqs_denied++;
+    }
+}
+
+static void probe_polled(uint16_t addr)
+{
+    int i;
+
+    for (i = 0; i < _idle_num_polled; i++) {
+        if (_idle_polled[i] == addr) {
+            return;
+        }
+    }
+    if (_idle_num_polled == CPU_IDLE_LOOP_MAX_POLLED) {
+        _probe_pure = false;
+        return;
+    }
+    _idle_polled[_idle_num_polled++] = addr;
+}
+
+static uint8_t probe_get(uint16_t addr)
+{
+    switch (_classify(addr, false)) {
+    case cpu_mem_stable:
+        break;
+    case cpu_mem_polled:
+        probe_polled(addr);
+        break;
+    default:
+        /* Reading could have side effects */
+        _probe_pure = false;
+        return 0;
+    }
+    return _probe_mem_get(addr);
+}
+
+static void probe_set(uint16_t addr, uint8_t val)
+{
+    /* Writing what is already there changes nothing */
+    if (_classify(addr, true) != cpu_mem_stable ||
+        _probe_mem_get(addr) != val) {
+        _probe_pure = false;
+    }
+}
+
+static inline bool same_state(const struct cpu_state *a,
+                              const struct cpu_state *b)
+{
+    return a->pc    == b->pc &&
+           a->reg_a == b->reg_a &&
+           a->reg_x == b->reg_x &&
+           a->reg_y == b->reg_y &&
+           a->flags == b->flags &&
+           a->sp    == b->sp;
+}
+
+/* Index of instruction executed after spinning instructions */
+static inline int idle_path_index(uint64_t instructions)
+{
+    if (instructions < (uint64_t)_idle_entry) {
+        return instructions;
+    }
+    return _idle_entry + (instructions - _idle_entry) %
+                         (_idle_path_length - _idle_entry);
+}
+
+/* Executes from PC without writing memory until a state repeats.
+ * The CPU is idle if it only reads stable or polled memory and
+ * writes nothing new on the way, it then spins in the loop from
+ * the repeated state until an interrupt or until polled memory
+ * changes. Returns the loop length in instructions, 0 if not idle. */
+static int probe_idle_loop()
+{
+    struct cpu_state   start = _state;
+    struct instruction instr;
+    cpu_mem_get        mem_get = _mem_get;
+    cpu_mem_get        mem_fetch = _mem_fetch;
+    cpu_mem_set        mem_set = _mem_set;
+    bool               irq_pending = _irq_pending;
+    bool               overflow = _stack_overflow;
+    bool               underflow = _stack_underflow;
+    int                length = 0;
+    int                i;
+
+    _probe_mem_get = _mem_peek;
+    _mem_get       = probe_get;
+    _mem_fetch     = probe_get;
+    _mem_set       = probe_set;
+    _probe_pure    = true;
+
+    _idle_num_polled  = 0;
+    _idle_path_length = 0;
+    while (!length && _idle_path_length < IDLE_PATH_MAX) {
+        _idle_path[_idle_path_length++] = _state;
+        fetch_and_decode(&instr);
+        execute(&instr);
+        if (!_probe_pure || _irq_pending) {
+            break;
+        }
+        for (i = _idle_path_length - 1; i >= 0; i--) {
+            if (same_state(&_state, &_idle_path[i])) {
+                _idle_entry = i;
+                length      = _idle_path_length - i;
+                break;
+            }
+        }
+    }
+    _mem_get   = mem_get;
+    _mem_fetch = mem_fetch;
+    _mem_set   = mem_set;
+
+    _state           = start;
+    _irq_pending     = irq_pending;
+    _stack_overflow  = overflow;
+    _stack_underflow = underflow;
+
+    if (length > IDLE_LOOP_MAX) {
+        length = 0;
+    }
+    return length;
+}
+
+/* Called when a jump at jump_pc went backwards, probes loops that
+ * are taken over and over. */
+static void detect_idle_loop(uint16_t jump_pc)
+{
+    if (_state.pc != _loop_start || jump_pc != _loop_end) {
+        _loop_start   = _state.pc;
+        _loop_end     = jump_pc;
+        _loop_count   = 0;
+        _loop_backoff = 0;
+        return;
+    }
+    if (_loop_backoff) {
+        _loop_backoff--;
+        return;
+    }
+    if (++_loop_count < IDLE_LOOP_ITERATIONS) {
+        return;
+    }
+    _idle_length = probe_idle_loop();
+    if (!_idle_length) {
+        _loop_backoff = IDLE_LOOP_BACKOFF;
+    }
+}
+
+/* Load or store in a copy or fill loop */
+struct loop_access {
+    bool     store;
+    bool     index_x;
+    uint16_t base;
+    /* Addresses accessed and host memory for them */
+    uint16_t first;
+    uint16_t last;
+    uint8_t  *pages[2];
+};
+
+static inline bool in_range(uint16_t addr, uint16_t first, uint16_t last)
+{
+    return (uint16_t)(addr - first) <= (uint16_t)(last - first);
+}
+
+static inline uint8_t *access_at(const struct loop_access *access,
+                                 uint16_t addr)
+{
+    int page = (addr >> 8) != (access->first >> 8);
+
+    return access->pages[page] + (addr & 0xff);
+}
+
+/* Stores only, or a load and a store, to contiguous host memory that
+ * do not overlap are memsets or a memcpy. */
+static bool loop_as_block(const struct loop_access *accesses,
+                          int num_accesses, int iterations, int step)
+{
+    const struct loop_access *load = &accesses[0];
+    const struct loop_access *store;
+    uint8_t                  *from;
+    uint8_t                  *to;
+    int                      a;
+
+    for (a = 0; a < num_accesses; a++) {
+        if (accesses[a].first > accesses[a].last ||
+            (accesses[a].pages[1] != accesses[a].pages[0] &&
+             accesses[a].pages[1] != accesses[a].pages[0] + 0x100)) {
+            return false;
+        }
+    }
+    if (load->store) {
+        for (a = 0; a < num_accesses; a++) {
+            if (!accesses[a].store) {
+                return false;
+            }
+        }
+        for (a = 0; a < num_accesses; a++) {
+            store = &accesses[a];
+            memset(access_at(store, store->first), _state.reg_a,
+                   iterations);
+        }
+        return true;
+    }
+    store = &accesses[1];
+    if (num_accesses != 2 || !store->store) {
+        return false;
+    }
+    from = access_at(load, load->first);
+    to   = access_at(store, store->first);
+    if (from + iterations > to && to + iterations > from) {
+        return false;
+    }
+    memcpy(to, from, iterations);
+    /* Loaded last */
+    _state.reg_a = step > 0 ? *access_at(load, load->last) : *from;
+    return true;
+}
+
+/* Called when BNE at end has jumped backwards with interrupts disabled.
+ * Recognizes loops of loads and stores indexed by X or Y that end
+ * incrementing or decrementing the index, like
+ *   LDA (src),Y / STA (dst),Y / INY / BNE
+ *   STA $0400,X / STA $0500,X / DEX / BNE
+ * and executes the iterations left natively when every access is to
+ * plain RAM and no store touches the loop or its pointers. Returns
+ * the number of instructions executed. */
+static int accelerate_loop(uint16_t end)
+{
+    struct loop_access accesses[COPY_LOOP_ACCESSES];
+    struct loop_access *access;
+    int                num_accesses = 0;
+    uint16_t           pointers[COPY_LOOP_ACCESSES];
+    int                num_pointers = 0;
+    uint16_t           start = _state.pc;
+    uint16_t           pc = start;
+    uint8_t            *index = NULL;
+    uint8_t            opcode;
+    uint8_t            first;
+    uint8_t            i;
+    int                step = 0;
+    int                iterations;
+    int                n;
+    int                a;
+
+    if ((uint16_t)(end - start) > COPY_LOOP_BYTES ||
+        _mem_get(end) != 0xd0) {
+        return 0;
+    }
+    while (pc != end) {
+        if (index || num_accesses == COPY_LOOP_ACCESSES) {
+            return 0;
+        }
+        access = &accesses[num_accesses];
+        opcode = _mem_get(pc);
+        switch (opcode) {
+        case 0xbd: /* LDA abs,X */
+        case 0xb9: /* LDA abs,Y */
+        case 0x9d: /* STA abs,X */
+        case 0x99: /* STA abs,Y */
+            access->index_x = opcode == 0xbd || opcode == 0x9d;
+            access->base    = _mem_get(pc + 1) | (_mem_get(pc + 2) << 8);
+            pc += 3;
+            break;
+        case 0xb1: /* LDA (zp),Y */
+        case 0x91: /* STA (zp),Y */
+            pointers[num_pointers] = _mem_get(pc + 1);
+            access->index_x = false;
+            access->base    = _mem_get(pointers[num_pointers]) |
+                (_mem_get((pointers[num_pointers] + 1) & 0xff) << 8);
+            num_pointers++;
+            pc += 2;
+            break;
+        case 0xe8: /* INX */
+        case 0xca: /* DEX */
+        case 0xc8: /* INY */
+        case 0x88: /* DEY */
+            index = opcode == 0xe8 || opcode == 0xca ? &_state.reg_x :
+                                                       &_state.reg_y;
+            step  = opcode == 0xe8 || opcode == 0xc8 ? 1 : -1;
+            pc++;
+            continue;
+        default:
+            return 0;
+        }
+        access->store = opcode == 0x9d || opcode == 0x99 || opcode == 0x91;
+        num_accesses++;
     }
+    if (!index || !num_accesses) {
+        return 0;
+    }
+
+    /* Index runs from where it is now until it wraps to 0 */
+    first      = *index;
+    iterations = step > 0 ? 0x100 - first : first;
+    for (a = 0; a < num_accesses; a++) {
+        access = &accesses[a];
+        if (access->index_x != (index == &_state.reg_x)) {
+            return 0;
+        }
+        access->first    = access->base + (step > 0 ? first : 0x01);
+        access->last     = access->base + (step > 0 ? 0xff : first);
+        access->pages[0] = _loop_page(access->first >> 8, access->store);
+        access->pages[1] = _loop_page(access->last >> 8, access->store);
+        if (!access->pages[0] || !access->pages[1]) {
+            return 0;
+        }
+        if (!access->store) {
+            continue;
+        }
+        /* Stores must not change the code or a pointer */
+        for (pc = start; pc != (uint16_t)(end + 2); pc++) {
+            if (in_range(pc, access->first, access->last)) {
+                return 0;
+            }
+        }
+        for (n = 0; n < num_pointers; n++) {
+            if (in_range(pointers[n], access->first, access->last) ||
+                in_range((pointers[n] + 1) & 0xff,
+                         access->first, access->last)) {
+                return 0;
+            }
+        }
+    }
+
+    if (!loop_as_block(accesses, num_accesses, iterations, step)) {
+        i = first;
+        for (n = 0; n < iterations; n++) {
+            for (a = 0; a < num_accesses; a++) {
+                access = &accesses[a];
+                if (access->store) {
+                    *access_at(access, access->base + i) = _state.reg_a;
+                }
+                else {
+                    _state.reg_a = *access_at(access, access->base + i);
+                }
+            }
+            i += step;
+        }
+    }
+
+    /* Leaves the loop with the index wrapped to 0 */
+    *index        = 0;
+    _state.flags |= FLAG_ZERO;
+    _state.flags &= ~FLAG_NEGATIVE;
+    _state.pc     = end + 2;
+
+    return iterations * (num_accesses + 2);
 }
 
-void cpu_step(struct cpu_state *state_out)
+static inline bool is_trapped(uint16_t address)
+{
+    return _trapped[address >> 3] & (1 << (address & 7));
+}
+
+int cpu_step(struct cpu_state *state_out)
 {
     struct instruction instr;
+    uint16_t           pc;
+    uint16_t           start;
+    int                executed = 0;
 
     if (_irq_pending) {
         interrupt_request();
         _irq_pending = false;
+        if (_call_graph) {
+            /* Return address and flags were pushed */
+            cpu_calls_enter(_state.pc, _state.sp + 3, true);
+        }
     }
 
-    /* Copy for debugging purposes. */
-    _state_before = _state;
+    pc = _state.pc;
+    if (__builtin_expect(is_trapped(pc), 0)) {
+        executed = _trap_handler(&_state);
+        if (executed && _profile) {
+            _profile[pc].instructions += executed;
+        }
+        if (executed && _call_graph) {
+            cpu_calls_leave(_state.sp);
+        }
+    }
+    if (!executed) {
+        if (TRACE_ON(_trace_execution)) {
+            execute_traced(&instr);
+        }
+        else {
+            fetch_and_decode(&instr);
+            execute(&instr);
+        }
+        executed = 1;
+        if (_profile) {
+            _profile[pc].instructions++;
+            _profile[pc].cycles += instr.operation->cycles;
+        }
+        if (_call_graph) {
+            track_calls(&instr);
+        }
 
-    fetch_and_decode(&instr);
-    execute(&instr);
+        if (__builtin_expect(_state.pc <= pc, 0)) {
+            if (_loop_page && (_state.flags & FLAG_IRQ_DISABLE)) {
+                start     = _state.pc;
+                executed += accelerate_loop(pc);
+                if (executed > 1 && _profile) {
+                    _profile[start].instructions += executed - 1;
+                }
+            }
+            if (_classify && executed == 1) {
+                detect_idle_loop(pc);
+            }
+        }
+    }
 
+    metrics.instructions += executed;
+    _state.instructions  += executed;
     if (state_out) {
         *state_out = _state;
     }
+    return executed;
+}
+
+void cpu_set_fetch(cpu_mem_get fetch)
+{
+    _mem_fetch = fetch ? fetch : _mem_get;
+}
+
+void cpu_set_store(cpu_mem_set store)
+{
+    _mem_set = store ? store : _mem_set_default;
+}
+
+void cpu_set_peek(cpu_mem_get peek)
+{
+    _mem_peek = peek ? peek : _mem_get;
+}
+
+void cpu_set_idle_detection(cpu_mem_classify classify)
+{
+    _classify    = classify;
+    _loop_start  = 0;
+    _loop_end    = 0;
+    _loop_count  = 0;
+    _idle_length = 0;
+}
+
+void cpu_set_loop_acceleration(cpu_mem_page page)
+{
+    _loop_page = page;
+}
+
+int cpu_idle_loop(uint16_t polled[CPU_IDLE_LOOP_MAX_POLLED],
+                  int *num_polled)
+{
+    int length = _idle_length;
+
+    if (length) {
+        memcpy(polled, _idle_polled, sizeof(_idle_polled));
+        *num_polled  = _idle_num_polled;
+        _idle_length = 0;
+    }
+    return length;
+}
+
+void cpu_run_idle(uint64_t instructions)
+{
+    int      i     = idle_path_index(instructions);
+    uint64_t count = _state.instructions + instructions;
+
+    metrics.instructions += instructions;
+    if (_profile) {
+        _profile[_idle_path[_idle_entry].pc].instructions += instructions;
+    }
+    _state              = _idle_path[i];
+    _state.instructions = count;
+}
+
+int cpu_idle_resume(uint16_t polled[CPU_IDLE_LOOP_MAX_POLLED],
+                    int *num_polled)
+{
+    int length = probe_idle_loop();
+
+    if (length) {
+        memcpy(polled, _idle_polled, sizeof(_idle_polled));
+        *num_polled = _idle_num_polled;
+    }
+    return length;
+}
+
+bool cpu_irq_pending()
+{
+    return _irq_pending;
+}
+
+void cpu_set_trap_handler(cpu_trap_handler handler)
+{
+    _trap_handler = handler;
+    memset(_trapped, 0, sizeof(_trapped));
+}
+
+void cpu_set_trap(uint16_t address, bool trapped)
+{
+    if (trapped && _trap_handler) {
+        _trapped[address >> 3] |= 1 << (address & 7);
+    }
+    else {
+        _trapped[address >> 3] &= ~(1 << (address & 7));
+    }
+}
+
+void cpu_set_call_graph(bool enable)
+{
+    if (enable && !_call_graph) {
+        cpu_calls_reset();
+    }
+    _call_graph = enable;
+}
+
+bool cpu_is_call_graph()
+{
+    return _call_graph;
+}
+
+bool cpu_set_profile(bool enable)
+{
+    if (enable && !_profile) {
+        _profile = calloc(65536, sizeof(*_profile));
+    }
+    if (!enable) {
+        free(_profile);
+        _profile = NULL;
+    }
+    return _profile != NULL || !enable;
+}
+
+bool cpu_is_profile()
+{
+    return _profile != NULL;
+}
+
+void cpu_profile_reset()
+{
+    if (_profile) {
+        memset(_profile, 0, 65536 * sizeof(*_profile));
+    }
+}
+
+const struct cpu_profile_entry *cpu_profile()
+{
+    return _profile;
 }
 
 static void get_instruction(uint16_t address,
@@ -1009,13 +1634,51 @@ void cpu_disassembly_at(int fd,
 {
     struct instruction instr;
     uint8_t offset;
+    char    line[40];
+    int     len;
 
     while (num_instructions--) {
         get_instruction(address, &instr, &offset);
-        trace_instruction(fd, address, &instr, 0);
+        len = format_instruction(line, sizeof(line) - 1, address,
+                                 &instr, 0);
+        line[len++] = '\n';
+        write(fd, line, len);
         address += offset;
-        write(fd, "\n", 1);
     }
     *next_address = address;
 }
 
+int cpu_trace_line(char *line, size_t size, const uint8_t bytes[3],
+                   const struct cpu_state *before,
+                   const struct cpu_state *after)
+{
+    struct instruction instr;
+    char               flags[9];
+    int                len;
+    const struct {
+        char    name;
+        uint8_t val0;
+        uint8_t val1;
+    } regs[] = {
+        { 'A', before->reg_a, after->reg_a },
+        { 'X', before->reg_x, after->reg_x },
+        { 'Y', before->reg_y, after->reg_y },
+        { 'S', before->sp,    after->sp    },
+    };
+
+    instr.operation   = &opcodes[bytes[0]];
+    instr.operands[0] = bytes[1];
+    instr.operands[1] = bytes[2];
+    format_flags(flags, after->flags);
+
+    len = format_instruction(line, size, before->pc, &instr, 10);
+    len += snprintf(line + len, size - len, "%s", flags);
+    for (int i = 0; i < 4; i++) {
+        if (regs[i].val0 != regs[i].val1) {
+            len += snprintf(line + len, size - len, " %c=$%02x",
+                            regs[i].name, regs[i].val1);
+        }
+    }
+    len += snprintf(line + len, size - len, "\n");
+    return len;
+}
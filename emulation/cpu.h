@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* Clocked at 1.023 Mhz NTSC or 0.985 Mhz PAL */
 /* Boost if VIC turned off */
@@ -23,6 +25,9 @@ struct cpu_state {
     uint8_t  reg_y;
     uint8_t  flags;
     uint8_t  sp;
+    /* Executed since reset, including those run by traps, accelerated
+     * or skipped. Tells apart the same PC at different times. */
+    uint64_t instructions;
 };
 
 typedef uint8_t (*cpu_mem_get)(uint16_t addr);
@@ -32,15 +37,125 @@ void cpu_init(cpu_mem_get mem_get,
               cpu_mem_set mem_set);
 void cpu_reset();
 
-void cpu_step(struct cpu_state *state_out);
+/* Executes one instruction, or a whole routine when a trap
+ * handles it. Returns number of instructions executed. */
+int cpu_step(struct cpu_state *state_out);
+
+/* Called instead of executing the instruction at a trapped address.
+ * Returns number of instructions the handler replaced, leaving the
+ * state as if they had been executed, or 0 to execute normally. */
+typedef int (*cpu_trap_handler)(struct cpu_state *state);
+
+/* Host memory behind a page when the CPU reads or writes it as
+ * plain RAM, otherwise NULL. */
+typedef uint8_t *(*cpu_mem_page)(uint8_t page, bool write);
+
+/* While interrupts are disabled, copy and fill loops indexed by X or
+ * Y over plain RAM are executed natively as a whole, reported like a
+ * trap replacing their instructions. Turned off when page is NULL. */
+void cpu_set_loop_acceleration(cpu_mem_page page);
+
+/* How memory behaves, for idle loop detection */
+enum cpu_mem_kind {
+    /* Access may have side effects */
+    cpu_mem_volatile,
+    /* Reading has no side effects, but the value may change by
+     * itself, like the raster line. */
+    cpu_mem_polled,
+    /* Only changes when the CPU writes it, and when writing, reading
+     * back gives what was written. */
+    cpu_mem_stable,
+};
+typedef enum cpu_mem_kind (*cpu_mem_classify)(uint16_t addr, bool write);
+
+/* Instructions are read with fetch instead of the mem_get given to
+ * cpu_init(), NULL to go back to mem_get. */
+void cpu_set_fetch(cpu_mem_get fetch);
+
+/* Data is written with store instead of the mem_set given to
+ * cpu_init(), NULL to go back to mem_set. */
+void cpu_set_store(cpu_mem_set store);
+
+/* Memory is read with peek instead of the mem_get given to cpu_init()
+ * when probing for idle loops, reads the CPU does not execute. NULL
+ * to go back to mem_get. */
+void cpu_set_peek(cpu_mem_get peek);
+
+/* Looks for loops that only read stable or polled memory and
+ * therefore spin until the next interrupt or until polled memory
+ * changes. Turned off when classify is NULL. */
+void cpu_set_idle_detection(cpu_mem_classify classify);
+
+#define CPU_IDLE_LOOP_MAX_POLLED 2
+
+/* Number of instructions in one iteration when the CPU has just
+ * been found spinning in an idle loop from PC, otherwise 0. Polled
+ * addresses read on the way are stored in polled. Reported once per
+ * detection. */
+int cpu_idle_loop(uint16_t polled[CPU_IDLE_LOOP_MAX_POLLED],
+                  int *num_polled);
+
+/* Moves the CPU as far as executing the given number of instructions
+ * of the idle loop would have, leaving interrupts pending. */
+void cpu_run_idle(uint64_t instructions);
+
+/* Call after cpu_run_idle() when polled memory has changed. Like
+ * cpu_idle_loop() for the loop the CPU spins in from now on, 0 if
+ * it will leave it. */
+int cpu_idle_resume(uint16_t polled[CPU_IDLE_LOOP_MAX_POLLED],
+                    int *num_polled);
+
+bool cpu_irq_pending();
+
+/* Removes all traps */
+void cpu_set_trap_handler(cpu_trap_handler handler);
+void cpu_set_trap(uint16_t address, bool trapped);
 
 void cpu_interrupt_request();
 
+/* Instructions executed at an address and their cycles from the
+ * opcode table, page crossings and taken branches not included.
+ * Instructions replaced by a trap, an accelerated loop or a skipped
+ * idle loop are counted where the routine or loop starts, without
+ * cycles. */
+struct cpu_profile_entry {
+    uint64_t instructions;
+    uint64_t cycles;
+};
+
+/* Counting costs two additions per instruction when on */
+bool cpu_set_profile(bool enable);
+bool cpu_is_profile();
+void cpu_profile_reset();
+/* Table of 65536 entries by address, NULL when profiling is off */
+const struct cpu_profile_entry *cpu_profile();
+
+/* Tracks calls to build a call graph, see cpu_calls.h. The graph
+ * is kept when turned off and starts over when turned on. */
+void cpu_set_call_graph(bool enable);
+bool cpu_is_call_graph();
+
+/* Line the execution trace writes for the instruction in bytes,
+ * given the registers before and after. Returns its length. */
+int cpu_trace_line(char *line, size_t size, const uint8_t bytes[3],
+                   const struct cpu_state *before,
+                   const struct cpu_state *after);
+
 /* For interactive use */
 void cpu_disassembly_at(int fd,
                         uint16_t address,
                         int num_instructions,
                         uint16_t *next_address);
 
+/* Complete CPU state for save states */
+struct cpu_saved_state {
+    struct cpu_state state;
+    bool             irq_pending;
+};
+
+void cpu_save_state(struct cpu_saved_state *saved);
+void cpu_restore_state(const struct cpu_saved_state *saved);
+
 /* For debug */
 void cpu_set_state(struct cpu_state *state);
+void cpu_get_state(struct cpu_state *state);
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu_calls.h"
+
+/* Deepest call stack followed, a routine called deeper than this is
+ * accounted to its caller. */
+#define MAX_DEPTH 128
+/* Most distinct paths, paths beyond are accounted to the caller */
+#define MAX_NODES (1 << 20)
+
+/* A routine called through a path of routines, the root is whatever
+ * ran before the graph was reset. */
+struct node {
+    uint16_t routine;
+    bool     interrupt;
+    int32_t  parent;
+    int32_t  child;
+    int32_t  sibling;
+    uint64_t calls;
+    uint64_t exclusive;
+};
+
+struct frame {
+    int32_t caller;
+    uint8_t return_sp;
+};
+
+static struct node  *_nodes;
+static int32_t      _num_nodes;
+static int32_t      _max_nodes;
+static struct frame _stack[MAX_DEPTH];
+static int          _depth;
+static int32_t      _current;
+
+void cpu_calls_reset()
+{
+    free(_nodes);
+    _max_nodes = 1024;
+    _nodes     = calloc(_max_nodes, sizeof(*_nodes));
+    _num_nodes = _nodes ? 1 : 0;
+    _depth     = 0;
+    _current   = 0;
+    if (_nodes) {
+        _nodes[0].parent  = -1;
+        _nodes[0].child   = -1;
+        _nodes[0].sibling = -1;
+    }
+}
+
+/* Child of parent for routine, created when called the first time.
+ * Parent itself when out of memory. */
+static int32_t find_child(int32_t parent, uint16_t routine,
+                          bool interrupt)
+{
+    struct node *nodes;
+    int32_t     child = _nodes[parent].child;
+
+    while (child != -1) {
+        if (_nodes[child].routine == routine &&
+            _nodes[child].interrupt == interrupt) {
+            return child;
+        }
+        child = _nodes[child].sibling;
+    }
+
+    if (_num_nodes == _max_nodes) {
+        if (_max_nodes == MAX_NODES) {
+            return parent;
+        }
+        nodes = realloc(_nodes, 2 * _max_nodes * sizeof(*_nodes));
+        if (!nodes) {
+            return parent;
+        }
+        _nodes      = nodes;
+        _max_nodes *= 2;
+    }
+    child = _num_nodes++;
+    memset(&_nodes[child], 0, sizeof(_nodes[child]));
+    _nodes[child].routine   = routine;
+    _nodes[child].interrupt = interrupt;
+    _nodes[child].parent    = parent;
+    _nodes[child].child     = -1;
+    _nodes[child].sibling   = _nodes[parent].child;
+    _nodes[parent].child    = child;
+    return child;
+}
+
+void cpu_calls_enter(uint16_t routine, uint8_t return_sp, bool interrupt)
+{
+    if (!_nodes || _depth == MAX_DEPTH) {
+        return;
+    }
+    _stack[_depth].caller    = _current;
+    _stack[_depth].return_sp = return_sp;
+    _depth++;
+    _current = find_child(_current, routine, interrupt);
+    _nodes[_current].calls++;
+}
+
+void cpu_calls_leave(uint8_t sp)
+{
+    while (_depth && sp >= _stack[_depth - 1].return_sp) {
+        _depth--;
+        _current = _stack[_depth].caller;
+    }
+}
+
+void cpu_calls_cycles(uint32_t cycles)
+{
+    if (_nodes) {
+        _nodes[_current].exclusive += cycles;
+    }
+}
+
+static uint32_t key_of(const struct node *node)
+{
+    return (node->interrupt ? 0x10000 : 0) | node->routine;
+}
+
+/* Most inclusive cycles first */
+static int compare_routines(const void *a, const void *b)
+{
+    const struct cpu_calls_routine *ra = a;
+    const struct cpu_calls_routine *rb = b;
+
+    if (ra->inclusive != rb->inclusive) {
+        return ra->inclusive < rb->inclusive ? 1 : -1;
+    }
+    return ra->address - rb->address;
+}
+
+int cpu_calls_routines(struct cpu_calls_routine *routines, int max)
+{
+    struct cpu_calls_routine *table;
+    uint64_t                 *totals;
+    int32_t                  ancestor;
+    int32_t                  i;
+    int                      num = 0;
+
+    if (!_nodes) {
+        return 0;
+    }
+    table  = calloc(2 * 65536, sizeof(*table));
+    totals = malloc(_num_nodes * sizeof(*totals));
+    if (!table || !totals) {
+        free(table);
+        free(totals);
+        return 0;
+    }
+
+    /* Children are always created after their parent */
+    for (i = 0; i < _num_nodes; i++) {
+        totals[i] = _nodes[i].exclusive;
+    }
+    for (i = _num_nodes - 1; i > 0; i--) {
+        totals[_nodes[i].parent] += totals[i];
+    }
+
+    for (i = 1; i < _num_nodes; i++) {
+        struct cpu_calls_routine *routine = &table[key_of(&_nodes[i])];
+
+        routine->address   = _nodes[i].routine;
+        routine->interrupt = _nodes[i].interrupt;
+        routine->calls     += _nodes[i].calls;
+        routine->exclusive += _nodes[i].exclusive;
+
+        /* Recursive calls are already included by the outermost */
+        ancestor = _nodes[i].parent;
+        while (ancestor > 0 &&
+               key_of(&_nodes[ancestor]) != key_of(&_nodes[i])) {
+            ancestor = _nodes[ancestor].parent;
+        }
+        if (ancestor <= 0) {
+            routine->inclusive += totals[i];
+        }
+    }
+
+    for (i = 0; i < 2 * 65536; i++) {
+        if (table[i].calls) {
+            table[num++] = table[i];
+        }
+    }
+    qsort(table, num, sizeof(*table), compare_routines);
+    if (num > max) {
+        num = max;
+    }
+    memcpy(routines, table, num * sizeof(*table));
+
+    free(table);
+    free(totals);
+    return num;
+}
+
+void cpu_calls_write_folded(int fd)
+{
+    int32_t path[MAX_DEPTH + 1];
+    char    line[16 * (MAX_DEPTH + 2)];
+    int     depth;
+    int     len;
+    int32_t i;
+    int32_t node;
+
+    for (i = 0; i < _num_nodes; i++) {
+        if (!_nodes[i].exclusive) {
+            continue;
+        }
+        depth = 0;
+        for (node = i; node > 0; node = _nodes[node].parent) {
+            path[depth++] = node;
+        }
+
+        len = snprintf(line, sizeof(line), "root");
+        while (depth--) {
+            node = path[depth];
+            len += snprintf(line + len, sizeof(line) - len,
+                            _nodes[node].interrupt ? ";irq_%04x" : ";%04x",
+                            _nodes[node].routine);
+        }
+        len += snprintf(line + len, sizeof(line) - len, " %llu\n",
+                        (unsigned long long)_nodes[i].exclusive);
+        write(fd, line, len);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Call graph of 6502 routines built from a shadow call stack.
+ *
+ * The CPU enters a routine on JSR and on interrupts. A routine is
+ * left when the stack pointer moves above the return address pushed
+ * when entering it, however that happens. RTS and RTI leave as
+ * expected, a routine dropping its return address with PLA/PLA
+ * is left together with its caller, and an RTS used as a jump to an
+ * address pushed by the routine itself does not leave it.
+ *
+ * Cycles are accounted to the path of routines that was active when
+ * they were spent. */
+
+struct cpu_calls_routine {
+    uint16_t address;
+    bool     interrupt;
+    uint64_t calls;
+    /* Cycles spent in the routine and in routines it called */
+    uint64_t inclusive;
+    /* Cycles spent in the routine itself */
+    uint64_t exclusive;
+};
+
+/* Frees the graph and starts over with an empty call stack */
+void cpu_calls_reset();
+
+/* Entered routine, return_sp is the stack pointer before the return
+ * address was pushed. */
+void cpu_calls_enter(uint16_t routine, uint8_t return_sp, bool interrupt);
+
+/* Leaves all routines whose return address is no longer on the
+ * stack at sp */
+void cpu_calls_leave(uint8_t sp);
+
+void cpu_calls_cycles(uint32_t cycles);
+
+/* Up to max routines with most inclusive cycles first, returns the
+ * number of routines. */
+int cpu_calls_routines(struct cpu_calls_routine *routines, int max);
+
+/* One line per path of routines with its own cycles, the format
+ * flame graph tools read. */
+void cpu_calls_write_folded(int fd);
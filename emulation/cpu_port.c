@@ -118,3 +118,26 @@ void cpu_port_init()
     mem_install_hooks_for_cpu(&install, 1);
 }
 
+
+void cpu_port_save_state(struct cpu_port_saved_state *saved)
+{
+    saved->data_direction_reg         = _data_direction_reg;
+    saved->data_direction_reg_shadow  = _data_direction_reg_shadow;
+    saved->peripheral_reg             = _peripheral_reg;
+    saved->peripheral_reg_shadow      = _peripheral_reg_shadow;
+    saved->line_cassette_motor_off    = _line_cassette_motor_off;
+    saved->line_cassette_write_data   = _line_cassette_write_data;
+    saved->line_cassette_sense_closed = _line_cassette_sense_closed;
+}
+
+void cpu_port_restore_state(const struct cpu_port_saved_state *saved)
+{
+    /* Memory configuration is restored by the PLA */
+    _data_direction_reg         = saved->data_direction_reg;
+    _data_direction_reg_shadow  = saved->data_direction_reg_shadow;
+    _peripheral_reg             = saved->peripheral_reg;
+    _peripheral_reg_shadow      = saved->peripheral_reg_shadow;
+    _line_cassette_motor_off    = saved->line_cassette_motor_off;
+    _line_cassette_write_data   = saved->line_cassette_write_data;
+    _line_cassette_sense_closed = saved->line_cassette_sense_closed;
+}
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #define CPU_PORT_DIR_IN  0
 #define CPU_PORT_DIR_OUT 1
 
@@ -18,5 +20,19 @@
 
 void cpu_port_init();
 
+/* Registers and lines for save states */
+struct cpu_port_saved_state {
+    uint8_t data_direction_reg;
+    uint8_t data_direction_reg_shadow;
+    uint8_t peripheral_reg;
+    uint8_t peripheral_reg_shadow;
+    uint8_t line_cassette_motor_off;
+    uint8_t line_cassette_write_data;
+    uint8_t line_cassette_sense_closed;
+};
+
+void cpu_port_save_state(struct cpu_port_saved_state *saved);
+void cpu_port_restore_state(const struct cpu_port_saved_state *saved);
+
 //void cpu_port_set_cassette_sense(bool play_pressed);
 
@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "c64.h"
+#include "mem.h"
+#include "input.h"
+#include "trace.h"
+#include "explore.h"
+
+#define SCREEN_ADDR 0x0400
+#define SCREEN_SIZE 1000
+
+/* A copy running, its pipe is closed by the end of the process */
+struct copy {
+    pid_t pid;
+    int   fd;
+};
+
+static void start_copy(int num, explore_fn run, void *ctx,
+                       struct explore_result *result, struct copy *copy)
+{
+    int fds[2];
+
+    copy->pid = -1;
+    copy->fd  = -1;
+    if (pipe(fds) != 0) {
+        return;
+    }
+    copy->pid = fork();
+    if (copy->pid == 0) {
+        close(fds[0]);
+        result->fitness = run(num, ctx);
+        result->cycles  = c64_cycles();
+        result->ok      = true;
+        /* Only what the copy printed, stdout was flushed before */
+        fflush(stdout);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (copy->pid > 0) {
+        copy->fd = fds[0];
+    }
+    else {
+        close(fds[0]);
+    }
+}
+
+/* Waits until copies end, whichever does first, and reaps them. The
+ * end of a pipe tells a copy ended, other children of the process
+ * are left to whoever started them. Returns the number reaped. */
+static int reap(struct copy *copies, struct pollfd *polled, int num)
+{
+    int reaped = 0;
+    int i;
+
+    /* Copies that ended are ignored, their fd is -1 */
+    for (i = 0; i < num; i++) {
+        polled[i].fd      = copies[i].fd;
+        polled[i].events  = POLLIN;
+        polled[i].revents = 0;
+    }
+    while (poll(polled, num, -1) == -1 && errno == EINTR)
+        ;
+    for (i = 0; i < num; i++) {
+        if (copies[i].fd == -1 || !polled[i].revents) {
+            continue;
+        }
+        close(copies[i].fd);
+        copies[i].fd = -1;
+        while (waitpid(copies[i].pid, NULL, 0) == -1 && errno == EINTR)
+            ;
+        reaped++;
+    }
+    return reaped;
+}
+
+bool explore(int num, int workers, explore_fn run, void *ctx,
+             struct explore_result *results)
+{
+    struct explore_result *shared;
+    size_t                size    = num * sizeof(*shared);
+    struct copy           *copies;
+    struct pollfd         *polled;
+    int                   running = 0;
+    int                   next    = 0;
+
+    if (input_is_recording() || input_is_replaying() ||
+        trace_binary_is_open()) {
+        return false;
+    }
+    if (num <= 0) {
+        return true;
+    }
+    copies = calloc(num, sizeof(*copies));
+    polled = calloc(num, sizeof(*polled));
+    if (!copies || !polled) {
+        free(copies);
+        free(polled);
+        return false;
+    }
+    shared = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        free(copies);
+        free(polled);
+        return false;
+    }
+    memset(shared, 0, size);
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    /* Else output pending is printed by every copy */
+    fflush(stdout);
+    while (next < num || running) {
+        if (next < num && running < workers) {
+            start_copy(next, run, ctx, &shared[next], &copies[next]);
+            if (copies[next].fd != -1) {
+                running++;
+            }
+            next++;
+            continue;
+        }
+        running -= reap(copies, polled, next);
+    }
+    memcpy(results, shared, size);
+    munmap(shared, size);
+    free(copies);
+    free(polled);
+    return true;
+}
+
+void explore_run(const struct explore_input *inputs, int num,
+                 uint64_t cycles)
+{
+    uint64_t start = c64_cycles();
+    uint64_t now;
+
+    for (now = 0; now < cycles; now = c64_cycles() - start) {
+        for (; num > 0 && inputs->cycle <= now; inputs++, num--) {
+            if (inputs->down) {
+                input_key_down(inputs->key);
+            }
+            else {
+                input_key_up(inputs->key);
+            }
+        }
+        c64_step();
+    }
+}
+
+static uint8_t screen_code(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 1;
+    }
+    if (c == '@') {
+        return 0;
+    }
+    return c;
+}
+
+bool explore_screen_has(const char *text)
+{
+    const uint8_t *screen = mem_get_ram(SCREEN_ADDR);
+    size_t        len     = strlen(text);
+    size_t        i;
+    size_t        j;
+
+    for (i = 0; i + len <= SCREEN_SIZE; i++) {
+        for (j = 0; j < len && screen[i + j] == screen_code(text[j]); j++)
+            ;
+        if (j == len) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* What-if runs from where the machine is now, to search for input
+ * that crashes a program or reaches a screen.
+ *
+ * The machine lives in globals, a copy of it is thus a forked
+ * process. ROMs and everything else not written are shared with the
+ * machine copied, its RAM is copied page by page as the copy writes
+ * to it. Copies run in parallel and hand back how well they did, the
+ * machine copied is left as it was. Host side effects are not undone,
+ * files written by SAVE or traces are those of all copies. */
+
+typedef double (*explore_fn)(int copy, void *ctx);
+
+struct explore_result {
+    /* False when the copy crashed */
+    bool     ok;
+    double   fitness;
+    uint64_t cycles;
+};
+
+/* Calls run(copy, ctx) in num copies of the machine, at most workers
+ * at a time, and fills in results with what each returned. Only the
+ * copies are waited for, other child processes are left alone. False
+ * and nothing run when the machine cannot be copied now, while an
+ * input log is recorded or replayed or a binary trace written. */
+bool explore(int num, int workers, explore_fn run, void *ctx,
+             struct explore_result *results);
+
+/* Key pressed or released some cycles into a run */
+struct explore_input {
+    uint64_t cycle;
+    uint16_t key;
+    bool     down;
+};
+
+/* Runs the machine for cycles from now with inputs, sorted by cycle.
+ * Input arrives between steps as it does from the front ends. */
+void explore_run(const struct explore_input *inputs, int num,
+                 uint64_t cycles);
+
+/* Whether the text screen at $0400 shows text, upper case letters,
+ * digits and punctuation only. */
+bool explore_screen_has(const char *text);
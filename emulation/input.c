@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c64.h"
+#include "mem.h"
+#include "vic.h"
+#include "keyboard.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "trap.h"
+#include "input.h"
+
+#define INPUT_LOG_MAGIC "C64I"
+
+/* Most recent inputs kept to apply again */
+#define HISTORY_SIZE 4096
+
+/* Decide where steps end and thus when input arrives */
+#define SETTING_IDLE_SKIP            0x01
+#define SETTING_LOOP_ACCELERATION    0x02
+/* Inverted, logs from before it have trap acceleration on */
+#define SETTING_NO_TRAP_ACCELERATION 0x04
+
+struct header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t rom_checksum;
+    uint32_t settings;
+    /* Frames not drawn leave the VIC behind on what it draws */
+    uint32_t run_ahead;
+    /* Else the log starts with a state */
+    uint32_t cold_boot;
+};
+
+/* A log is the header followed by events, each the cycles since the
+ * previous event as a 7 bit varint, the kind and what it carries.
+ * After a state the cycles count from the cycle restored. */
+enum event {
+    event_key_down = 1,  /* Key */
+    event_key_up,        /* Key */
+    event_load,          /* Start, size, bytes */
+    event_color_ram,     /* Offset, number, value byte */
+    event_vic_reg,       /* Register and value bytes */
+    event_state,         /* Size, serialized state */
+    event_end,
+};
+
+/* Input as applied, to apply it again when executing forward from an
+ * earlier state. Loads and replaced states are not kept, the machine
+ * cannot go back past them. */
+struct kept {
+    uint64_t   cycle;
+    enum event event;
+    uint16_t   a;
+    uint16_t   b;
+    uint8_t    val;
+};
+
+static struct kept _history[HISTORY_SIZE];
+static uint32_t    _history_first;
+static uint32_t    _history_count;
+/* Cycle input is kept after, complete from then on */
+static uint64_t    _kept_since;
+/* Next kept input to apply again */
+static uint32_t    _rerun;
+static bool        _rerunning;
+
+static FILE     *_record;
+static uint64_t _recorded;
+
+/* Whole log being replayed and where in it */
+static uint8_t       *_log;
+static const uint8_t *_pos;
+static const uint8_t *_end;
+static uint64_t      _replayed;
+static bool          _broken;
+
+/* Cycle the next event counts from */
+static uint64_t _base;
+/* Scratch for states */
+static uint8_t  *_state;
+
+static uint8_t *put_varint(uint8_t *out, uint64_t val)
+{
+    while (val >= 0x80) {
+        *out++ = val | 0x80;
+        val >>= 7;
+    }
+    *out++ = val;
+    return out;
+}
+
+static bool get_varint(uint64_t *val)
+{
+    int shift = 0;
+
+    *val = 0;
+    do {
+        if (_pos == _end || shift > 63) {
+            return false;
+        }
+        *val |= (uint64_t)(*_pos & 0x7f) << shift;
+        shift += 7;
+    } while (*_pos++ & 0x80);
+    return true;
+}
+
+/* Kind and one or two numbers, data follows separately */
+static void record(enum event event, uint64_t a, uint64_t b)
+{
+    uint8_t buf[32];
+    uint8_t *out = buf;
+
+    out    = put_varint(out, c64_cycles() - _base);
+    *out++ = event;
+    switch (event) {
+    case event_key_down:
+    case event_key_up:
+    case event_state:
+        out = put_varint(out, a);
+        break;
+    case event_load:
+    case event_color_ram:
+        out = put_varint(out, a);
+        out = put_varint(out, b);
+        break;
+    case event_vic_reg:
+        *out++ = a;
+        *out++ = b;
+        break;
+    case event_end:
+        break;
+    }
+    fwrite(buf, 1, out - buf, _record);
+    _base = c64_cycles();
+    _recorded++;
+}
+
+/* State after it was replaced, the next event counts from there */
+static void record_state()
+{
+    size_t size = savestate_size();
+
+    savestate_write(_state);
+    record(event_state, size, 0);
+    fwrite(_state, 1, size, _record);
+}
+
+static void keep(enum event event, uint16_t a, uint16_t b, uint8_t val)
+{
+    struct kept *kept;
+
+    if (_history_count == HISTORY_SIZE) {
+        _kept_since    = _history[_history_first].cycle;
+        _history_first = (_history_first + 1) % HISTORY_SIZE;
+        _history_count--;
+    }
+    kept        = &_history[(_history_first + _history_count) % HISTORY_SIZE];
+    kept->cycle = c64_cycles();
+    kept->event = event;
+    kept->a     = a;
+    kept->b     = b;
+    kept->val   = val;
+    _history_count++;
+}
+
+/* The machine state was replaced, input before cannot be applied
+ * again. */
+static void forget()
+{
+    _history_count = 0;
+    _kept_since    = c64_cycles();
+}
+
+static void fill_color_ram(uint16_t offset, uint8_t val, uint16_t num)
+{
+    uint8_t *color_ram = mem_get_color_ram_for_vic();
+
+    if (offset >= 1024) {
+        return;
+    }
+    if (offset + num > 1024) {
+        num = 1024 - offset;
+    }
+    memset(color_ram + offset, val, num);
+}
+
+/* Input that is kept */
+static void apply(enum event event, uint16_t a, uint16_t b, uint8_t val)
+{
+    switch (event) {
+    case event_key_down:
+        keyboard_down(a);
+        break;
+    case event_key_up:
+        keyboard_up(a);
+        break;
+    case event_color_ram:
+        fill_color_ram(a, val, b);
+        break;
+    case event_vic_reg:
+        vic_reg_set(val, 0xd000 + a, NULL);
+        break;
+    default:
+        break;
+    }
+}
+
+void input_key_down(uint16_t key)
+{
+    if (_log) {
+        return;
+    }
+    apply(event_key_down, key, 0, 0);
+    keep(event_key_down, key, 0, 0);
+    if (_record) {
+        record(event_key_down, key, 0);
+    }
+}
+
+void input_key_up(uint16_t key)
+{
+    if (_log) {
+        return;
+    }
+    apply(event_key_up, key, 0, 0);
+    keep(event_key_up, key, 0, 0);
+    if (_record) {
+        record(event_key_up, key, 0);
+    }
+}
+
+int input_load_prg(const char *path, uint16_t *start, uint16_t *size)
+{
+    if (_log || c64_load_prg(path, start, size) != 0) {
+        return -1;
+    }
+    forget();
+    if (_record) {
+        record(event_load, *start, *size);
+        fwrite(mem_get_ram(*start), 1, *size, _record);
+    }
+    return 0;
+}
+
+void input_color_ram_fill(uint16_t offset, uint8_t val, uint16_t num)
+{
+    if (_log) {
+        return;
+    }
+    apply(event_color_ram, offset, num, val);
+    keep(event_color_ram, offset, num, val);
+    if (_record) {
+        record(event_color_ram, offset, num);
+        fputc(val, _record);
+    }
+}
+
+void input_vic_reg_set(uint16_t reg, uint8_t val)
+{
+    if (_log) {
+        return;
+    }
+    apply(event_vic_reg, reg, 0, val);
+    keep(event_vic_reg, reg, 0, val);
+    if (_record) {
+        record(event_vic_reg, reg, val);
+    }
+}
+
+bool input_restore_state(const char *path)
+{
+    if (_log || !savestate_restore(path)) {
+        return false;
+    }
+    forget();
+    if (_record) {
+        record_state();
+    }
+    return true;
+}
+
+bool input_rewind_back()
+{
+    if (_log || !rewind_back()) {
+        return false;
+    }
+    forget();
+    if (_record) {
+        record_state();
+    }
+    return true;
+}
+
+bool input_record(const char *path)
+{
+    struct header header;
+
+    input_stop();
+    _state = malloc(savestate_size());
+    if (!_state) {
+        return false;
+    }
+    _record = fopen(path, "wb");
+    if (!_record) {
+        free(_state);
+        _state = NULL;
+        return false;
+    }
+
+    memcpy(header.magic, INPUT_LOG_MAGIC, sizeof(header.magic));
+    header.version      = INPUT_LOG_VERSION;
+    header.rom_checksum = c64_rom_checksum();
+    header.settings     =
+        (c64_is_idle_skip() ? SETTING_IDLE_SKIP : 0) |
+        (c64_is_loop_acceleration() ? SETTING_LOOP_ACCELERATION : 0) |
+        (trap_is_acceleration() ? 0 : SETTING_NO_TRAP_ACCELERATION);
+    header.run_ahead    = c64_get_run_ahead();
+    header.cold_boot    = c64_cycles() == 0;
+    fwrite(&header, sizeof(header), 1, _record);
+
+    _base     = c64_cycles();
+    _recorded = 0;
+    if (!header.cold_boot) {
+        record_state();
+    }
+    return true;
+}
+
+static bool read_log(const char *path)
+{
+    FILE *f;
+    long size;
+    bool ok;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    ok = fseek(f, 0, SEEK_END) == 0 &&
+         (size = ftell(f)) > 0 &&
+         fseek(f, 0, SEEK_SET) == 0;
+    _log = ok ? malloc(size) : NULL;
+    ok = _log && fread(_log, size, 1, f) == 1;
+    fclose(f);
+    if (!ok) {
+        free(_log);
+        _log = NULL;
+        return false;
+    }
+    _pos = _log;
+    _end = _log + size;
+    return true;
+}
+
+bool input_replay(const char *path)
+{
+    struct header header;
+
+    input_stop();
+    if (!read_log(path)) {
+        return false;
+    }
+    if ((size_t)(_end - _pos) < sizeof(header)) {
+        input_stop();
+        return false;
+    }
+    memcpy(&header, _pos, sizeof(header));
+    if (memcmp(header.magic, INPUT_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != INPUT_LOG_VERSION ||
+        header.rom_checksum != c64_rom_checksum() ||
+        (header.cold_boot && c64_cycles() != 0) ||
+        !c64_set_run_ahead(header.run_ahead)) {
+        input_stop();
+        return false;
+    }
+    _pos += sizeof(header);
+
+    c64_set_idle_skip(header.settings & SETTING_IDLE_SKIP);
+    c64_set_loop_acceleration(header.settings & SETTING_LOOP_ACCELERATION);
+    trap_set_acceleration(!(header.settings & SETTING_NO_TRAP_ACCELERATION));
+    _base     = c64_cycles();
+    _replayed = 0;
+    _broken   = false;
+    forget();
+    /* Input at the start, the state of a log that has one */
+    c64_set_input_due(input_apply());
+    return !_broken;
+}
+
+void input_stop()
+{
+    if (_record) {
+        record(event_end, 0, 0);
+        fclose(_record);
+        _record = NULL;
+    }
+    free(_log);
+    free(_state);
+    _log   = NULL;
+    _state = NULL;
+    c64_set_input_due(UINT64_MAX);
+}
+
+bool input_is_recording()
+{
+    return _record != NULL;
+}
+
+bool input_is_replaying()
+{
+    return _log != NULL;
+}
+
+/* Applies the event at the current position, false when the log is
+ * broken. */
+static bool apply_event()
+{
+    uint64_t a;
+    uint64_t b   = 0;
+    uint8_t  val = 0;
+    uint8_t  event;
+
+    if (_pos == _end) {
+        return false;
+    }
+    event = *_pos++;
+    switch (event) {
+    case event_key_down:
+    case event_key_up:
+        if (!get_varint(&a)) {
+            return false;
+        }
+        break;
+    case event_load:
+        if (!get_varint(&a) || !get_varint(&b) ||
+            a + b > 0x10000 || (uint64_t)(_end - _pos) < b) {
+            return false;
+        }
+        memcpy(mem_get_ram(a), _pos, b);
+        mem_set_dirty(a, b);
+        _pos += b;
+        break;
+    case event_color_ram:
+        if (!get_varint(&a) || !get_varint(&b) || _pos == _end) {
+            return false;
+        }
+        val = *_pos++;
+        break;
+    case event_vic_reg:
+        if (_end - _pos < 2) {
+            return false;
+        }
+        a     = _pos[0];
+        val   = _pos[1];
+        _pos += 2;
+        break;
+    case event_state:
+        if (!get_varint(&a) || (uint64_t)(_end - _pos) < a ||
+            !savestate_read(_pos, a)) {
+            return false;
+        }
+        _pos += a;
+        break;
+    default:
+        return false;
+    }
+    if (event == event_load || event == event_state) {
+        forget();
+    }
+    else {
+        apply(event, a, b, val);
+        keep(event, a, b, val);
+    }
+    _base = c64_cycles();
+    _replayed++;
+    return true;
+}
+
+static const struct kept *kept_at(uint32_t index)
+{
+    return &_history[(_history_first + index) % HISTORY_SIZE];
+}
+
+uint64_t input_kept_since()
+{
+    return _kept_since;
+}
+
+void input_rerun(uint64_t cycle)
+{
+    _rerun = 0;
+    while (_rerun < _history_count && kept_at(_rerun)->cycle < cycle) {
+        _rerun++;
+    }
+    _rerunning = true;
+    c64_set_input_due(input_apply());
+}
+
+void input_rerun_end()
+{
+    if (!_rerunning) {
+        return;
+    }
+    /* What was not applied again has not happened yet */
+    _history_count = _rerun;
+    _rerunning     = false;
+    c64_set_input_due(UINT64_MAX);
+    if (_record) {
+        record_state();
+    }
+}
+
+void input_rerun_done()
+{
+    _rerunning = false;
+}
+
+/* Kept input up to now again, returns the cycle of the next */
+static uint64_t apply_kept()
+{
+    const struct kept *kept;
+
+    while (_rerun < _history_count) {
+        kept = kept_at(_rerun);
+        if (kept->cycle > c64_cycles()) {
+            return kept->cycle;
+        }
+        apply(kept->event, kept->a, kept->b, kept->val);
+        _rerun++;
+    }
+    return UINT64_MAX;
+}
+
+uint64_t input_apply()
+{
+    const uint8_t *event;
+    uint64_t      cycles;
+
+    if (_rerunning) {
+        return apply_kept();
+    }
+    while (_log) {
+        event = _pos;
+        /* Cut short when the recording crashed */
+        if (!get_varint(&cycles) || _pos == _end) {
+            input_stop();
+            break;
+        }
+        if (_base + cycles > c64_cycles()) {
+            _pos = event;
+            return _base + cycles;
+        }
+        if (*_pos == event_end) {
+            input_stop();
+            break;
+        }
+        if (!apply_event()) {
+            printf("Broken input log, replay stopped\n");
+            _broken = true;
+            input_stop();
+        }
+    }
+    return UINT64_MAX;
+}
+
+void input_stat()
+{
+    if (_record) {
+        printf("Input          : recording\n");
+        printf("Events         : %llu\n", (unsigned long long)_recorded);
+        printf("Log            : %ld bytes\n", ftell(_record));
+    }
+    else if (_log) {
+        printf("Input          : replaying\n");
+        printf("Events         : %llu\n", (unsigned long long)_replayed);
+        printf("Log            : %ld of %ld bytes\n",
+               (long)(_pos - _log), (long)(_end - _log));
+    }
+    else {
+        printf("Input          : live\n");
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Everything done to the machine from outside goes through here,
+ * keys pressed in the front ends and programs loaded, memory changed
+ * and states restored from the monitor. There is no joystick.
+ *
+ * While recording, each input is written to a log together with the
+ * emulated cycle it arrived at. Replaying the log applies each input
+ * at the same cycle again and reproduces the session bit for bit.
+ * Meanwhile input from outside is ignored.
+ *
+ * A log starts at cold boot when the machine has not run yet,
+ * otherwise with the complete machine state. Input arrives between
+ * steps, the log thus keeps idle skipping and loop acceleration which
+ * decide where steps end, and how many frames are run ahead. Traps
+ * and the drive directory are not kept and must be the same when
+ * replaying. */
+
+#define INPUT_LOG_VERSION 1
+
+void input_key_down(uint16_t key);
+void input_key_up(uint16_t key);
+
+/* See c64_load_prg(), the program is logged, not the path */
+int input_load_prg(const char *path, uint16_t *start, uint16_t *size);
+
+/* Sets num bytes of color RAM from offset to val */
+void input_color_ram_fill(uint16_t offset, uint8_t val, uint16_t num);
+void input_vic_reg_set(uint16_t reg, uint8_t val);
+
+/* Replace the machine state, logged as the complete new state */
+bool input_restore_state(const char *path);
+bool input_rewind_back();
+
+bool input_record(const char *path);
+/* Starts from the state the log starts with, a log from cold boot
+ * only replays on a machine that has not run yet. */
+bool input_replay(const char *path);
+/* Ends recording or replaying */
+void input_stop();
+bool input_is_recording();
+bool input_is_replaying();
+
+/* Input is kept for a while to apply it again when the machine
+ * executes forward from an earlier state, see reverse.h. States taken
+ * at or before the cycle returned are missing some of it. */
+uint64_t input_kept_since();
+/* Applies kept input again as emulated time passes, from the state
+ * restored at cycle, until input_rerun_end(). The input not applied
+ * again by then is dropped. */
+void input_rerun(uint64_t cycle);
+void input_rerun_end();
+/* Ends input_rerun() when the machine is back where it was, with all
+ * kept input applied again. The caller sets when input is due. */
+void input_rerun_done();
+
+/* Called by the machine between steps once emulated time reaches
+ * the cycle of the next input, returns the cycle of the one after. */
+uint64_t input_apply();
+
+void input_stat();
@@ -44,6 +44,18 @@ void keyboard_reset()
     _data_port_A = 0;
 }
 
+void keyboard_save_state(struct keyboard_saved_state *saved)
+{
+    memcpy(saved->lines, _lines, sizeof(_lines));
+    saved->data_port_A = _data_port_A;
+}
+
+void keyboard_restore_state(const struct keyboard_saved_state *saved)
+{
+    memcpy(_lines, saved->lines, sizeof(_lines));
+    _data_port_A = saved->data_port_A;
+}
+
 void keyboard_down(uint16_t key)
 {
     int line;
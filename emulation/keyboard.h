@@ -103,6 +103,15 @@ uint8_t keyboard_get_port_B(uint8_t interesting_bits);
 void keyboard_set_port_A(uint8_t lines, uint8_t valid_lines);
 void keyboard_set_port_B(uint8_t lines, uint8_t valid_lines);
 
+/* Key matrix for save states */
+struct keyboard_saved_state {
+    uint8_t lines[8];
+    uint8_t data_port_A;
+};
+
+void keyboard_save_state(struct keyboard_saved_state *saved);
+void keyboard_restore_state(const struct keyboard_saved_state *saved);
+
 void keyboard_trace_keys(int fd);
 void keyboard_trace_port_set(int fd);
 void keyboard_trace_port_get(int fd);
@@ -5,18 +5,24 @@
 #include <unistd.h>
 
 #include "mem.h"
+#include "perf.h"
+#include "coverage.h"
 
 uint8_t _ram[65536];
 uint8_t _color_ram[1024];
 
 
 struct mem_hooks {
-    mem_set_hook set_hook;
-    mem_get_hook get_hook;
+    mem_set_hook       set_hook;
+    mem_get_hook       get_hook;
+    enum metrics_hooks owner;
 };
 
 struct mem_hooks _cpu_hooks[256];
 
+/* Pages of RAM written since last cleared */
+static bool _dirty[256];
+
 
 void mem_init()
 {
@@ -33,34 +39,82 @@ void mem_reset()
 {
     memset(_ram, 0, sizeof(_ram));
     memset(_color_ram, 0, sizeof(_color_ram));
+    mem_set_dirty(0, sizeof(_ram));
 }
 
 void mem_set_for_cpu(uint16_t addr, uint8_t val)
 {
-    uint8_t          page   = addr >> 8;
-    struct mem_hooks *hooks = &_cpu_hooks[page];
+    uint8_t             page  = addr >> 8;
+    struct mem_hooks    *hooks = &_cpu_hooks[page];
+    enum perf_subsystem from;
 
+    coverage_record(coverage_cpu_write, addr);
+    _dirty[page] = true;
     if (hooks->set_hook) {
+        metrics.hook_calls[hooks->owner]++;
+        from = perf_switch(perf_mem_hooks);
         hooks->set_hook(val, addr, &_ram[addr]);
+        perf_switch(from);
     }
     else {
         _ram[addr] = val;
     }
 }
 
-uint8_t mem_get_for_cpu(uint16_t addr)
+static inline uint8_t get(uint16_t addr)
 {
-    uint8_t          page   = addr >> 8;
-    struct mem_hooks *hooks = &_cpu_hooks[page];
+    uint8_t             page  = addr >> 8;
+    struct mem_hooks    *hooks = &_cpu_hooks[page];
+    enum perf_subsystem from;
+    uint8_t             val;
 
     if (hooks->get_hook) {
-        return hooks->get_hook(addr, &_ram[addr]);
+        metrics.hook_calls[hooks->owner]++;
+        from = perf_switch(perf_mem_hooks);
+        val  = hooks->get_hook(addr, &_ram[addr]);
+        perf_switch(from);
+        return val;
     }
     else {
         return _ram[addr];
     }
 }
 
+uint8_t mem_get_for_cpu(uint16_t addr)
+{
+    coverage_record(coverage_cpu_read, addr);
+    return get(addr);
+}
+
+uint8_t mem_fetch_for_cpu(uint16_t addr)
+{
+    coverage_record(coverage_cpu_fetch, addr);
+    return get(addr);
+}
+
+uint8_t mem_peek_for_cpu(uint16_t addr)
+{
+    struct mem_hooks *hooks = &_cpu_hooks[addr >> 8];
+
+    if (hooks->get_hook) {
+        return hooks->get_hook(addr, &_ram[addr]);
+    }
+    return _ram[addr];
+}
+
+uint8_t* mem_get_page_for_cpu(uint8_t page, bool write)
+{
+    struct mem_hooks *hooks = &_cpu_hooks[page];
+
+    if (write ? hooks->set_hook != NULL : hooks->get_hook != NULL) {
+        return NULL;
+    }
+    if (write) {
+        _dirty[page] = true;
+    }
+    return &_ram[page << 8];
+}
+
 void mem_install_hooks_for_cpu(const struct mem_hook_install *install,
                                int num_install)
 {
@@ -71,6 +125,7 @@ void mem_install_hooks_for_cpu(const struct mem_hook_install *install,
         while (num_pages--) {
             _cpu_hooks[page_index].set_hook = install->set_hook;
             _cpu_hooks[page_index].get_hook = install->get_hook;
+            _cpu_hooks[page_index].owner    = install->owner;
             page_index++;
         }
 
@@ -118,3 +173,38 @@ uint8_t* mem_get_ram(uint16_t addr)
     return &_ram[addr];
 }
 
+void mem_save_state(struct mem_saved_state *saved)
+{
+    memcpy(saved->ram, _ram, sizeof(_ram));
+    memcpy(saved->color_ram, _color_ram, sizeof(_color_ram));
+}
+
+void mem_restore_state(const struct mem_saved_state *saved)
+{
+    memcpy(_ram, saved->ram, sizeof(_ram));
+    memcpy(_color_ram, saved->color_ram, sizeof(_color_ram));
+    mem_set_dirty(0, sizeof(_ram));
+}
+
+void mem_set_dirty(uint16_t addr, uint32_t size)
+{
+    uint32_t page;
+
+    if (!size) {
+        return;
+    }
+    for (page = addr >> 8; page <= (addr + size - 1) >> 8; page++) {
+        _dirty[page & 0xff] = true;
+    }
+}
+
+const bool* mem_dirty_pages()
+{
+    return _dirty;
+}
+
+void mem_clear_dirty()
+{
+    memset(_dirty, 0, sizeof(_dirty));
+}
+
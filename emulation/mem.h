@@ -1,6 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "metrics.h"
 
 /* Mem access is 2Mhz. Interleaved between CPU and VIC.*/
 
@@ -12,8 +15,21 @@ void mem_reset();
 uint8_t mem_get_for_cpu(uint16_t addr);
 void mem_set_for_cpu(uint16_t addr,
                      uint8_t val);
+/* Same as mem_get_for_cpu() for instruction bytes, tells them apart
+ * in the coverage. */
+uint8_t mem_fetch_for_cpu(uint16_t addr);
+/* Same as mem_get_for_cpu() for reads the CPU does not execute, like
+ * polling a register while an idle loop is skipped. Not counted in
+ * metrics, host time or coverage, only for addresses reading has no
+ * side effects on. */
+uint8_t mem_peek_for_cpu(uint16_t addr);
+
+/* RAM behind page when the CPU reads or writes it without a hook,
+ * NULL when ROM or I/O is mapped there. */
+uint8_t* mem_get_page_for_cpu(uint8_t page, bool write);
 
-/* VIC uses raw memory access */
+/* VIC uses raw memory access, writes through it are not tracked as
+ * dirty, see mem_set_dirty(). */
 uint8_t* mem_get_ram(uint16_t addr);
 uint8_t* mem_get_color_ram_for_vic();
 
@@ -25,10 +41,12 @@ typedef uint8_t (*mem_get_hook)(uint16_t absolute,
 
 
 struct mem_hook_install {
-    mem_set_hook set_hook;
-    mem_get_hook get_hook;
-    uint8_t      page_start;
-    uint8_t      num_pages;
+    mem_set_hook       set_hook;
+    mem_get_hook       get_hook;
+    uint8_t            page_start;
+    uint8_t            num_pages;
+    /* Calls are counted for it in the metrics */
+    enum metrics_hooks owner;
 };
 
 void mem_install_hooks_for_cpu(const struct mem_hook_install *install,
@@ -40,3 +58,19 @@ uint8_t mem_color_ram_get(uint16_t absolute, uint8_t *ram);
 
 void mem_dump_ram(int fd, uint16_t addr, uint16_t num);
 
+/* RAM contents for save states */
+struct mem_saved_state {
+    uint8_t ram[65536];
+    uint8_t color_ram[1024];
+};
+
+void mem_save_state(struct mem_saved_state *saved);
+void mem_restore_state(const struct mem_saved_state *saved);
+
+/* Pages of RAM written by the CPU, by a reset or restore, or marked
+ * with mem_set_dirty() since last cleared. Lets incremental snapshots
+ * skip pages that have not changed. Color RAM is not tracked. */
+void mem_set_dirty(uint16_t addr, uint32_t size);
+const bool* mem_dirty_pages();
+void mem_clear_dirty();
+
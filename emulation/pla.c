@@ -11,12 +11,13 @@
 #include "vic.h"
 #include "sid.h"
 #include "trace.h"
+#include "metrics.h"
 
 
 /* Images */
-uint8_t *_rom_kernal;
-uint8_t *_rom_basic;
-uint8_t *_rom_chargen;
+const uint8_t *_rom_kernal;
+const uint8_t *_rom_basic;
+const uint8_t *_rom_chargen;
 
 /* Pins */
 uint8_t _loram;
@@ -116,18 +117,21 @@ const struct mem_hook_install _kernal_hook = {
     .page_start = 0xe0,
     .num_pages  = 32,
     .get_hook   = mem_get_kernal,
+    .owner      = metrics_hooks_rom,
 };
 
 const struct mem_hook_install _basic_hook = {
     .page_start = 0xa0,
     .num_pages  = 8192 / 256,
     .get_hook   = mem_get_basic,
+    .owner      = metrics_hooks_rom,
 };
 
 const struct mem_hook_install _charen_hook = {
     .page_start = 0xd0,
     .num_pages  = 4096 / 256,
     .get_hook   = mem_get_charen,
+    .owner      = metrics_hooks_rom,
 };
 
 /* IO area is:
@@ -145,30 +149,35 @@ const struct mem_hook_install _io_hooks[] = {
         .num_pages = 0x400 / 0x100,
         .set_hook = vic_reg_set,
         .get_hook = vic_reg_get,
+        .owner = metrics_hooks_vic,
     },
     {
         .page_start = 0xd4,
         .num_pages = 0x400 / 0x100,
         .set_hook = sid_reg_set,
         .get_hook = sid_reg_get,
+        .owner = metrics_hooks_sid,
     },
     {
         .page_start = 0xd8,
         .num_pages = 0x400 / 0x100,
         .set_hook = mem_color_ram_set,
         .get_hook = mem_color_ram_get,
+        .owner = metrics_hooks_color_ram,
     },
     {
         .page_start = 0xdc,
         .num_pages = 0x100 / 0x100,
         .set_hook = cia1_reg_set,
         .get_hook = cia1_reg_get,
+        .owner = metrics_hooks_cia1,
     },
     {
         .page_start = 0xdd,
         .num_pages = 0x100 / 0x100,
         .set_hook = cia2_reg_set,
         .get_hook = cia2_reg_get,
+        .owner = metrics_hooks_cia2,
     },
 };
 
@@ -264,9 +273,9 @@ static void apply_config(struct config *new, struct config *old)
     }
 }
 
-void pla_init(uint8_t *rom_kernal,
-              uint8_t *rom_basic,
-              uint8_t *rom_chargen)
+void pla_init(const uint8_t *rom_kernal,
+              const uint8_t *rom_basic,
+              const uint8_t *rom_chargen)
 {
     _rom_kernal   = rom_kernal;
     _rom_basic   = rom_basic;
@@ -297,11 +306,35 @@ void pla_pins_from_cpu(bool pin_loram,
 {
     uint8_t prev_config_index = _config_index;
 
+    metrics.pla_configs++;
     _config_index = calculate_config_index();
     apply_config(&_configs[_config_index],
                  &_configs[prev_config_index]);
 }
 
+void pla_save_state(struct pla_saved_state *saved)
+{
+    saved->loram        = _loram;
+    saved->hiram        = _hiram;
+    saved->charen       = _charen;
+    saved->exrom        = _exrom;
+    saved->game         = _game;
+    saved->config_index = _config_index;
+}
+
+void pla_restore_state(const struct pla_saved_state *saved)
+{
+    _loram        = saved->loram;
+    _hiram        = saved->hiram;
+    _charen       = saved->charen;
+    _exrom        = saved->exrom;
+    _game         = saved->game;
+    _config_index = saved->config_index;
+
+    /* Reinstall all hooks, previous configuration is unknown */
+    apply_config(&_configs[_config_index], &_configs[32]);
+}
+
 bool pla_is_basic_mapped()
 {
     /* Basic can only reside in these pages */
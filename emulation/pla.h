@@ -9,9 +9,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-void pla_init(uint8_t *rom_kernal,
-              uint8_t *rom_basic,
-              uint8_t *rom_chargen);
+void pla_init(const uint8_t *rom_kernal,
+              const uint8_t *rom_basic,
+              const uint8_t *rom_chargen);
 
 void pla_reset();
 
@@ -20,6 +20,19 @@ void pla_pins_from_cpu(bool loram_high,
                        bool hiram_high,
                        bool charen_high);
 
+/* Pins and bank configuration for save states */
+struct pla_saved_state {
+    uint8_t loram;
+    uint8_t hiram;
+    uint8_t charen;
+    uint8_t exrom;
+    uint8_t game;
+    uint8_t config_index;
+};
+
+void pla_save_state(struct pla_saved_state *saved);
+void pla_restore_state(const struct pla_saved_state *saved);
+
 /* For debugging */
 bool pla_is_basic_mapped();
 bool pla_is_kernal_mapped();
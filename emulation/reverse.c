@@ -0,0 +1,146 @@
+#include <stdio.h>
+
+#include "c64.h"
+#include "cpu.h"
+#include "mem.h"
+#include "rewind.h"
+#include "input.h"
+#include "reverse.h"
+
+/* Settings to go back to, forward execution is done without */
+static bool _idle_skip;
+static bool _loop_acceleration;
+static int  _run_ahead;
+
+static uint16_t _watched;
+static bool     _written;
+
+static void watch_store(uint16_t addr, uint8_t val)
+{
+    if (addr == _watched) {
+        _written = true;
+    }
+    mem_set_for_cpu(addr, val);
+}
+
+static uint64_t instructions()
+{
+    struct cpu_state state;
+
+    cpu_get_state(&state);
+    return state.instructions;
+}
+
+/* Every instruction its own step, frames ahead would be seen as
+ * executed. */
+static bool begin()
+{
+    if (!rewind_is_enabled() || input_is_replaying()) {
+        return false;
+    }
+    _idle_skip         = c64_is_idle_skip();
+    _loop_acceleration = c64_is_loop_acceleration();
+    _run_ahead         = c64_get_run_ahead();
+    c64_set_idle_skip(false);
+    c64_set_loop_acceleration(false);
+    c64_set_run_ahead(0);
+    return true;
+}
+
+static void end()
+{
+    input_rerun_end();
+    c64_set_idle_skip(_idle_skip);
+    c64_set_loop_acceleration(_loop_acceleration);
+    c64_set_run_ahead(_run_ahead);
+}
+
+/* Newest snapshot with at most count instructions executed */
+static bool restore_at_most(uint64_t count)
+{
+    if (!rewind_back_to(count, input_kept_since())) {
+        return false;
+    }
+    input_rerun(c64_cycles());
+    return true;
+}
+
+/* Executes forward to the last step that ends at or before count */
+static void run_to(uint64_t count)
+{
+    uint64_t start;
+
+    while (instructions() < count) {
+        start = instructions();
+        c64_step();
+        if (instructions() > count) {
+            /* A trapped routine ran past, the snapshot it started
+             * from or a newer one reaches where it started. */
+            restore_at_most(start);
+            run_to(start);
+            return;
+        }
+    }
+}
+
+bool reverse_step(uint64_t num)
+{
+    uint64_t now = instructions();
+    uint64_t target;
+    bool     ok;
+
+    if (!begin()) {
+        return false;
+    }
+    target = num < now ? now - num : 0;
+    ok     = restore_at_most(target);
+    if (ok) {
+        run_to(target);
+    }
+    end();
+    return ok;
+}
+
+bool reverse_to_write(uint16_t addr)
+{
+    uint64_t now   = instructions();
+    uint64_t until = now;
+    uint64_t from;
+    uint64_t start;
+    uint64_t write = 0;
+    bool     found = false;
+
+    if (!begin()) {
+        return false;
+    }
+
+    /* Scans back snapshot by snapshot, the last write in a scan is
+     * the one wanted. */
+    _watched = addr;
+    cpu_set_store(watch_store);
+    while (!found && until > 0 && restore_at_most(until - 1)) {
+        from = instructions();
+        while (instructions() < until) {
+            start    = instructions();
+            _written = false;
+            c64_step();
+            if (_written) {
+                found = true;
+                write = start;
+            }
+        }
+        until = from;
+    }
+    cpu_set_store(NULL);
+
+    if (found) {
+        restore_at_most(write);
+        run_to(write);
+    }
+    else if (until != now) {
+        restore_at_most(now);
+        run_to(now);
+    }
+    end();
+    return found;
+}
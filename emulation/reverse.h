@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Moves the machine backwards in time. The newest rewind snapshot
+ * before where it goes is restored and the machine executes forward
+ * again, an instruction per step and with the input that arrived
+ * meanwhile, until it gets there. Reaches back as far as the rewind
+ * history and the input kept, see input.h, and not while an input
+ * log is replayed.
+ *
+ * Steps end between instructions, except that a trapped routine
+ * runs as one step. Both stop before such a routine when it would
+ * be entered in the middle. */
+
+/* Back num instructions. False and nothing changed when the history
+ * does not reach that far. */
+bool reverse_step(uint64_t num);
+
+/* Back to before the last instruction that wrote to addr. Stores by
+ * trapped routines are not seen. False when there is none in the
+ * history, the machine is then where it was. */
+bool reverse_to_write(uint16_t addr);
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "c64.h"
+#include "mem.h"
+#include "rewind.h"
+
+/* Most snapshots kept regardless of budget */
+#define MAX_SNAPSHOTS 8192
+
+/* Bytes of the saved state that are RAM */
+#define RAM_OFFSET offsetof(struct c64_saved_state, mem.ram)
+#define RAM_SIZE   sizeof(((struct c64_saved_state*)0)->mem.ram)
+
+/* Difference between a snapshot and the one after it. A sequence of
+ * unchanged byte counts and changed byte counts followed by the
+ * changed bytes XORed, the counts as 7 bit varints. */
+struct delta {
+    uint8_t  *data;
+    uint32_t size;
+    /* Of the snapshot it restores */
+    uint64_t cycles;
+    uint64_t instructions;
+};
+
+struct encoder {
+    uint8_t  *out;
+    uint32_t skip;
+};
+
+static bool     _enabled;
+static uint32_t _period = REWIND_DEFAULT_PERIOD;
+static size_t   _budget = REWIND_DEFAULT_BUDGET;
+
+/* Newest snapshot whole, and room for the next */
+static struct c64_saved_state *_last;
+static struct c64_saved_state *_next;
+/* Worst case encoding of a delta */
+static uint8_t                *_scratch;
+
+/* Ring of deltas, oldest first */
+static struct delta _deltas[MAX_SNAPSHOTS];
+static uint32_t     _first;
+static uint32_t     _count;
+static size_t       _bytes;
+
+static uint8_t *put_varint(uint8_t *out, uint32_t val)
+{
+    while (val >= 0x80) {
+        *out++ = val | 0x80;
+        val >>= 7;
+    }
+    *out++ = val;
+    return out;
+}
+
+static const uint8_t *get_varint(const uint8_t *in, uint32_t *val)
+{
+    int shift = 0;
+
+    *val = 0;
+    do {
+        *val |= (uint32_t)(*in & 0x7f) << shift;
+        shift += 7;
+    } while (*in++ & 0x80);
+    return in;
+}
+
+/* Up to 4, a changed run only ends at a few unchanged bytes in a row,
+ * a count costs more than a single byte. */
+static inline int unchanged_run(const uint8_t *a, const uint8_t *b,
+                                size_t n)
+{
+    int run = 0;
+
+    while (run < 4 && (size_t)run < n && a[run] == b[run]) {
+        run++;
+    }
+    return run;
+}
+
+static void encode(struct encoder *e, const uint8_t *a, const uint8_t *b,
+                   size_t n)
+{
+    size_t i = 0;
+    size_t start;
+
+    while (i < n) {
+        if (a[i] == b[i]) {
+            e->skip++;
+            i++;
+            continue;
+        }
+        start = i;
+        while (i < n && unchanged_run(a + i, b + i, n - i) < 4) {
+            i++;
+        }
+        e->out = put_varint(e->out, e->skip);
+        e->out = put_varint(e->out, i - start);
+        while (start < i) {
+            *e->out++ = a[start] ^ b[start];
+            start++;
+        }
+        e->skip = 0;
+    }
+}
+
+/* XOR of a and b into the scratch buffer, returns its size */
+static uint32_t encode_delta(const struct c64_saved_state *a,
+                             const struct c64_saved_state *b)
+{
+    const uint8_t  *pa    = (const uint8_t*)a;
+    const uint8_t  *pb    = (const uint8_t*)b;
+    const bool     *dirty = mem_dirty_pages();
+    struct encoder e      = { _scratch, 0 };
+    int            page;
+
+    encode(&e, pa, pb, RAM_OFFSET);
+    for (page = 0; page < 256; page++) {
+        if (!dirty[page] ||
+            memcmp(pa + RAM_OFFSET + page * 256,
+                   pb + RAM_OFFSET + page * 256, 256) == 0) {
+            e.skip += 256;
+            continue;
+        }
+        encode(&e, pa + RAM_OFFSET + page * 256,
+               pb + RAM_OFFSET + page * 256, 256);
+    }
+    encode(&e, pa + RAM_OFFSET + RAM_SIZE, pb + RAM_OFFSET + RAM_SIZE,
+           sizeof(*a) - RAM_OFFSET - RAM_SIZE);
+    return e.out - _scratch;
+}
+
+static void apply_delta(struct c64_saved_state *state,
+                        const struct delta *delta)
+{
+    uint8_t       *out = (uint8_t*)state;
+    const uint8_t *in  = delta->data;
+    const uint8_t *end = delta->data + delta->size;
+    uint32_t      skip;
+    uint32_t      len;
+
+    while (in < end) {
+        in = get_varint(in, &skip);
+        in = get_varint(in, &len);
+        out += skip;
+        while (len--) {
+            *out++ ^= *in++;
+        }
+    }
+}
+
+static void drop_oldest()
+{
+    struct delta *oldest = &_deltas[_first];
+
+    _bytes -= oldest->size;
+    free(oldest->data);
+    oldest->data = NULL;
+    _first = (_first + 1) % MAX_SNAPSHOTS;
+    _count--;
+}
+
+static void drop_all()
+{
+    while (_count) {
+        drop_oldest();
+    }
+    _first = 0;
+}
+
+static void take_snapshot()
+{
+    struct c64_saved_state *swap;
+    struct delta           *delta;
+    uint32_t               size;
+
+    c64_save_state(_next);
+    size = encode_delta(_last, _next);
+    mem_clear_dirty();
+
+    swap  = _last;
+    _last = _next;
+    _next = swap;
+
+    if (_count == MAX_SNAPSHOTS) {
+        drop_oldest();
+    }
+    delta       = &_deltas[(_first + _count) % MAX_SNAPSHOTS];
+    delta->data = malloc(size);
+    if (!delta->data) {
+        /* Older history is unreachable without it */
+        drop_all();
+        return;
+    }
+    memcpy(delta->data, _scratch, size);
+    delta->size         = size;
+    delta->cycles       = _next->cycles;
+    delta->instructions = _next->cpu.state.instructions;
+    _bytes += size;
+    _count++;
+
+    while (_count && _bytes + 2 * sizeof(*_last) > _budget) {
+        drop_oldest();
+    }
+}
+
+bool rewind_enable(bool enable)
+{
+    bool ok = true;
+
+    if (enable == _enabled) {
+        return true;
+    }
+    if (enable) {
+        _last    = calloc(1, sizeof(*_last));
+        _next    = calloc(1, sizeof(*_next));
+        _scratch = malloc(2 * sizeof(*_last));
+        ok       = _last && _next && _scratch;
+        enable   = ok;
+        if (ok) {
+            c64_save_state(_last);
+            mem_clear_dirty();
+        }
+    }
+    if (!enable) {
+        drop_all();
+        free(_last);
+        free(_next);
+        free(_scratch);
+        _last    = NULL;
+        _next    = NULL;
+        _scratch = NULL;
+    }
+    _enabled = enable;
+    return ok;
+}
+
+bool rewind_is_enabled()
+{
+    return _enabled;
+}
+
+void rewind_set_period(uint32_t frames)
+{
+    _period = frames ? frames : 1;
+}
+
+void rewind_set_budget(size_t bytes)
+{
+    _budget = bytes;
+}
+
+void rewind_frame()
+{
+    /* Also when time went backwards through a restored state */
+    if (_enabled && c64_frames() - _last->frames >= _period) {
+        take_snapshot();
+    }
+}
+
+bool rewind_back()
+{
+    struct delta *newest;
+
+    if (!_enabled) {
+        return false;
+    }
+    /* Still at the newest snapshot, back to the one before it */
+    if (c64_cycles() == _last->cycles) {
+        if (!_count) {
+            return false;
+        }
+        newest = &_deltas[(_first + _count - 1) % MAX_SNAPSHOTS];
+        apply_delta(_last, newest);
+        _bytes -= newest->size;
+        free(newest->data);
+        newest->data = NULL;
+        _count--;
+    }
+    c64_restore_state(_last);
+    mem_clear_dirty();
+    return true;
+}
+
+bool rewind_back_to(uint64_t instructions, uint64_t after_cycle)
+{
+    const struct delta *delta;
+    uint32_t           steps = 0;
+    uint32_t           i;
+
+    if (!_enabled) {
+        return false;
+    }
+    if (c64_cycles() != _last->cycles) {
+        steps++;
+        if (_last->cpu.state.instructions <= instructions) {
+            return _last->cycles > after_cycle && rewind_back();
+        }
+    }
+    for (i = _count; i > 0; i--) {
+        delta = &_deltas[(_first + i - 1) % MAX_SNAPSHOTS];
+        steps++;
+        if (delta->instructions <= instructions) {
+            if (delta->cycles <= after_cycle) {
+                return false;
+            }
+            while (steps--) {
+                rewind_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t rewind_depth()
+{
+    if (!_enabled) {
+        return 0;
+    }
+    return _count + (c64_cycles() != _last->cycles);
+}
+
+void rewind_stat()
+{
+    uint64_t frames = _enabled && _count ?
+        (uint64_t)_count * _period : 0;
+
+    printf("Rewind         : %s\n", _enabled ? "on" : "off");
+    printf("Period         : %u frames\n", _period);
+    printf("Budget         : %zu KB\n", _budget / 1024);
+    if (!_enabled) {
+        return;
+    }
+    printf("Snapshots      : %u\n", rewind_depth());
+    printf("Deltas         : %zu KB, %zu bytes per snapshot\n",
+           _bytes / 1024, _count ? _bytes / _count : 0);
+    printf("History        : about %.1f s\n", frames / 50.0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* History of machine states to step back through.
+ *
+ * A snapshot is taken every period frames. Only the newest snapshot
+ * is kept whole, each older one is kept as the difference to the one
+ * after it, XORed and run length encoded. RAM pages that have not
+ * been written since the previous snapshot are not even compared.
+ * The oldest snapshots are dropped to stay within the memory budget.
+ *
+ * Stepping back discards the history after the state stepped back
+ * to, there is no stepping forward again. */
+
+#define REWIND_DEFAULT_PERIOD 5
+#define REWIND_DEFAULT_BUDGET (16 << 20)
+
+/* Off until enabled, the history is dropped when turned off. False
+ * when out of memory. */
+bool rewind_enable(bool enable);
+bool rewind_is_enabled();
+
+/* Frames between snapshots and bytes used at most, including the
+ * newest snapshot. Take effect from the next snapshot. */
+void rewind_set_period(uint32_t frames);
+void rewind_set_budget(size_t bytes);
+
+/* Called by the machine between steps when a frame is complete */
+void rewind_frame();
+
+/* Restores the newest snapshot taken before the current state,
+ * false when there is none. */
+bool rewind_back();
+
+/* Steps back to the newest snapshot taken with at most instructions
+ * executed, as rewind_back() would. False and nothing changed when
+ * there is none or when it was taken at or before after_cycle. */
+bool rewind_back_to(uint64_t instructions, uint64_t after_cycle);
+
+/* Number of snapshots that can be stepped back to */
+uint32_t rewind_depth();
+
+void rewind_stat();
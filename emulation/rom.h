@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+/* ROM images linked into the executable, generated from
+ * rom/ by tools/bin2c when built with embed_roms. */
+
+#define ROM_BASIC_SIZE   8192
+#define ROM_KERNAL_SIZE  8192
+#define ROM_CHARGEN_SIZE 4096
+
+extern const uint8_t rom_basic[ROM_BASIC_SIZE];
+extern const uint8_t rom_kernal[ROM_KERNAL_SIZE];
+extern const uint8_t rom_chargen[ROM_CHARGEN_SIZE];
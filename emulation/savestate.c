@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "c64.h"
+#include "savestate.h"
+
+#define SAVESTATE_MAGIC "C64S"
+
+struct header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t rom_checksum;
+    uint32_t num_chunks;
+};
+
+struct chunk_header {
+    char     id[4];
+    uint32_t version;
+    uint32_t size;
+};
+
+/* Where in struct c64_saved_state a chunk is kept */
+struct chunk {
+    char     id[4];
+    uint32_t version;
+    size_t   offset;
+    size_t   size;
+};
+
+#define CHUNK(id, version, member)                                  \
+    { id, version, offsetof(struct c64_saved_state, member),        \
+      sizeof(((struct c64_saved_state*)0)->member) }
+
+static const struct chunk _chunks[] = {
+    CHUNK("CPU ", 2, cpu),
+    CHUNK("MEM ", 1, mem),
+    CHUNK("CIA1", 1, cia1),
+    CHUNK("CIA2", 1, cia2),
+    CHUNK("VIC ", 1, vic),
+    CHUNK("PLA ", 1, pla),
+    CHUNK("PORT", 1, cpu_port),
+    CHUNK("KEYB", 1, keyboard),
+    /* VIC and CPU interleave and emulated time, the rest of the
+     * struct */
+    { "MACH", 1, offsetof(struct c64_saved_state, vic_skips),
+      sizeof(struct c64_saved_state) -
+      offsetof(struct c64_saved_state, vic_skips) },
+};
+
+#define NUM_CHUNKS (sizeof(_chunks) / sizeof(_chunks[0]))
+
+/* Static so padding is always zero and equal states serialize to
+ * equal bytes. */
+static struct c64_saved_state _saved;
+
+size_t savestate_size()
+{
+    size_t size = sizeof(struct header);
+    size_t i;
+
+    for (i = 0; i < NUM_CHUNKS; i++) {
+        size += sizeof(struct chunk_header) + _chunks[i].size;
+    }
+    return size;
+}
+
+void savestate_write(uint8_t *buf)
+{
+    struct header       header;
+    struct chunk_header chunk;
+    size_t              i;
+
+    memcpy(header.magic, SAVESTATE_MAGIC, sizeof(header.magic));
+    header.version      = SAVESTATE_VERSION;
+    header.rom_checksum = c64_rom_checksum();
+    header.num_chunks   = NUM_CHUNKS;
+    memcpy(buf, &header, sizeof(header));
+    buf += sizeof(header);
+
+    c64_save_state(&_saved);
+    for (i = 0; i < NUM_CHUNKS; i++) {
+        memcpy(chunk.id, _chunks[i].id, sizeof(chunk.id));
+        chunk.version = _chunks[i].version;
+        chunk.size    = _chunks[i].size;
+        memcpy(buf, &chunk, sizeof(chunk));
+        buf += sizeof(chunk);
+        memcpy(buf, (uint8_t*)&_saved + _chunks[i].offset, chunk.size);
+        buf += chunk.size;
+    }
+}
+
+static const struct chunk *find_chunk(const char id[4])
+{
+    size_t i;
+
+    for (i = 0; i < NUM_CHUNKS; i++) {
+        if (memcmp(_chunks[i].id, id, sizeof(_chunks[i].id)) == 0) {
+            return &_chunks[i];
+        }
+    }
+    return NULL;
+}
+
+bool savestate_read(const uint8_t *buf, size_t size)
+{
+    const uint8_t       *end = buf + size;
+    const struct chunk  *known;
+    struct header       header;
+    struct chunk_header chunk;
+    uint32_t            found = 0;
+    uint32_t            i;
+
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, buf, sizeof(header));
+    buf += sizeof(header);
+    if (memcmp(header.magic, SAVESTATE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SAVESTATE_VERSION ||
+        header.rom_checksum != c64_rom_checksum()) {
+        return false;
+    }
+
+    for (i = 0; i < header.num_chunks; i++) {
+        if ((size_t)(end - buf) < sizeof(chunk)) {
+            return false;
+        }
+        memcpy(&chunk, buf, sizeof(chunk));
+        buf += sizeof(chunk);
+        if ((size_t)(end - buf) < chunk.size) {
+            return false;
+        }
+        known = find_chunk(chunk.id);
+        if (known) {
+            if (chunk.version != known->version ||
+                chunk.size != known->size) {
+                return false;
+            }
+            memcpy((uint8_t*)&_saved + known->offset, buf, chunk.size);
+            found |= 1 << (known - _chunks);
+        }
+        buf += chunk.size;
+    }
+    if (found != (1 << NUM_CHUNKS) - 1) {
+        return false;
+    }
+
+    c64_restore_state(&_saved);
+    return true;
+}
+
+bool savestate_save(const char *path)
+{
+    size_t  size = savestate_size();
+    uint8_t *buf = malloc(size);
+    char    tmp[1024];
+    FILE    *f;
+    bool    ok;
+
+    if (!buf) {
+        return false;
+    }
+    savestate_write(buf);
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    f = fopen(tmp, "wb");
+    if (!f) {
+        free(buf);
+        return false;
+    }
+    ok = fwrite(buf, size, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    free(buf);
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool savestate_restore(const char *path)
+{
+    uint8_t *buf;
+    long    size;
+    FILE    *f;
+    bool    ok;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    ok = fseek(f, 0, SEEK_END) == 0 &&
+         (size = ftell(f)) > 0 &&
+         fseek(f, 0, SEEK_SET) == 0;
+    buf = ok ? malloc(size) : NULL;
+    ok = buf && fread(buf, size, 1, f) == 1;
+    fclose(f);
+
+    ok = ok && savestate_read(buf, size);
+    free(buf);
+    return ok;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Complete machine state, ROMs excluded, as a versioned binary
+ * format.
+ *
+ * A header with the format version and the ROM checksum is followed
+ * by one chunk per device, each with its own id, version and size.
+ * A chunk holds the device's saved state struct as is, saving and
+ * restoring is thus a copy per device. Readers skip chunks they do
+ * not know and refuse the state when a chunk they need is missing or
+ * has another version. The byte order is the host's.
+ *
+ * Bump the version of a chunk whenever the struct it holds changes. */
+
+#define SAVESTATE_VERSION 1
+
+/* Bytes of a serialized state, the same for every state */
+size_t savestate_size();
+
+/* Saves the machine to buf of savestate_size() bytes */
+void savestate_write(uint8_t *buf);
+
+/* Restores the machine from a state of size bytes, false and the
+ * machine untouched when the state cannot be restored. */
+bool savestate_read(const uint8_t *buf, size_t size);
+
+/* Written to a temporary file and renamed, other processes never see
+ * a partial state. */
+bool savestate_save(const char *path);
+bool savestate_restore(const char *path);
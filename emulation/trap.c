@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+#include "cpu.h"
+#include "mem.h"
+#include "pla.h"
+#include "trap.h"
+
+/* Only device natively served by LOAD and SAVE */
+#define DRIVE 8
+
+/* KERNAL error codes returned in A */
+#define ERROR_FILE_NOT_FOUND 0x04
+
+/* Zero page and system variables */
+#define ZP_SAL      0xac
+#define ZP_EAL      0xae
+#define ZP_STAL     0xc1
+#define ZP_MEMUSS   0xc3
+#define ZP_PNT      0xd1
+#define ZP_LDTB1    0xd9
+#define ZP_USER     0xf3
+#define ZP_STATUS   0x90
+#define ZP_VERCK    0x93
+#define ZP_TAPE1    0xb2
+#define ZP_FNLEN    0xb7
+#define ZP_SA       0xb9
+#define ZP_FA       0xba
+#define ZP_FNADR    0xbb
+#define ADDR_MEMSTR 0x0281
+#define ADDR_MEMSIZ 0x0283
+#define ADDR_COLOR  0x0286
+#define ADDR_HIBASE 0x0288
+#define ADDR_LDTB2  0xecf0
+
+/* Serial status */
+#define STATUS_VERIFY 0x10
+#define STATUS_EOI    0x40
+
+typedef int (*trap_handler)(struct cpu_state *state);
+
+struct trap {
+    const char   *name;
+    uint16_t     address;
+    trap_handler handler;
+    /* Replaces the disk drive rather than ROM code */
+    bool         drive;
+    bool         enabled;
+    uint64_t     hits;
+};
+
+static char _directory[1024] = ".";
+
+static bool _acceleration;
+
+static struct trace_point *_trace_trap;
+
+static inline uint8_t get(uint16_t address)
+{
+    return mem_get_for_cpu(address);
+}
+
+static inline void set(uint16_t address, uint8_t val)
+{
+    mem_set_for_cpu(address, val);
+}
+
+/* Pointer is read from zero page on every access, like the CPU does */
+static inline uint16_t indirect_y(uint8_t zp, uint8_t y)
+{
+    return (get(zp) | get((uint8_t)(zp + 1)) << 8) + y;
+}
+
+static inline void set_nz(struct cpu_state *state, uint8_t val)
+{
+    state->flags &= ~(FLAG_NEGATIVE | FLAG_ZERO);
+    state->flags |= val & FLAG_NEGATIVE;
+    if (val == 0) {
+        state->flags |= FLAG_ZERO;
+    }
+}
+
+/* Leaves the return address of a JSR at address on the stack, as a
+ * called subroutine that has returned does. */
+static void jsr_from(struct cpu_state *state, uint16_t address)
+{
+    uint16_t ret = address + 2;
+
+    set(0x100 + state->sp, ret >> 8);
+    set(0x100 + (uint8_t)(state->sp - 1), ret & 0xff);
+}
+
+static void rts(struct cpu_state *state)
+{
+    uint16_t lo;
+    uint16_t hi;
+
+    lo = get(0x100 + ++state->sp);
+    hi = get(0x100 + ++state->sp);
+    state->pc = ((hi << 8) | lo) + 1;
+}
+
+/* RAMTAS $fd50, clears work pages and finds the top of RAM by
+ * writing test patterns to every byte from $0400. */
+static int ramtas(struct cpu_state *state)
+{
+    int      executed = 0;
+    uint16_t address;
+    uint8_t  page;
+    uint8_t  saved;
+    int      y;
+
+    for (y = 0; y < 0x100; y++) {
+        set(0x0002 + y, 0x00);
+        set(0x0200 + y, 0x00);
+        set(0x0300 + y, 0x00);
+    }
+    /* LDA TAY, loop of STA STA STA INY BNE */
+    executed += 2 + 0x100 * 5;
+
+    set(ZP_TAPE1, 0x3c);
+    set(ZP_TAPE1 + 1, 0x03);
+    set(ZP_STAL + 1, 0x03);
+    executed += 7;
+
+    for (;;) {
+        page = get(ZP_STAL + 1) + 1;
+        set(ZP_STAL + 1, page);
+        executed++;
+
+        for (y = 0; y < 0x100; y++) {
+            address = indirect_y(ZP_STAL, y);
+            saved   = get(address);
+            set(address, 0x55);
+            if (get(address) != 0x55) {
+                executed += 6;
+                goto found;
+            }
+            /* ROL of $55 with carry set by CMP */
+            set(address, 0xab);
+            if (get(address) != 0xab) {
+                executed += 10;
+                goto found;
+            }
+            set(address, saved);
+            executed += 14;
+        }
+        /* BEQ back to INC */
+        executed++;
+    }
+
+found:
+    /* Top of memory through MEMTOP $fe2d */
+    state->reg_x = y;
+    state->reg_y = get(ZP_STAL + 1);
+    jsr_from(state, 0xfd8d);
+    set(ADDR_MEMSIZ, state->reg_x);
+    set(ADDR_MEMSIZ + 1, state->reg_y);
+    set(ADDR_MEMSTR + 1, 0x08);
+    set(ADDR_HIBASE, 0x04);
+    state->reg_a  = 0x04;
+    state->flags &= ~FLAG_CARRY;
+    set_nz(state, state->reg_a);
+    rts(state);
+
+    /* TYA TAX LDY CLC JSR, STX STY RTS, LDA STA LDA STA RTS */
+    return executed + 13;
+}
+
+/* Pointer to screen line X in PNT, $e9f0 */
+static void set_line_pointer(uint8_t x)
+{
+    set(ZP_PNT, get(ADDR_LDTB2 + x));
+    set(ZP_PNT + 1, (get((uint8_t)(ZP_LDTB1 + x)) & 0x03) |
+                    get(ADDR_HIBASE));
+}
+
+/* Pointer to color RAM of PNT in USER, $ea24 */
+static void set_color_pointer()
+{
+    set(ZP_USER, get(ZP_PNT));
+    set(ZP_USER + 1, (get(ZP_PNT + 1) & 0x03) | 0xd8);
+}
+
+/* CLRLN $e9ff, fills screen line X with spaces in current color */
+static int clear_line(struct cpu_state *state)
+{
+    int y;
+
+    set_line_pointer(state->reg_x);
+    set_color_pointer();
+    for (y = 0x27; y >= 0; y--) {
+        set(indirect_y(ZP_USER, y), get(ADDR_COLOR));
+        set(indirect_y(ZP_PNT, y), 0x20);
+    }
+    jsr_from(state, 0xea07);
+
+    state->reg_a = 0x20;
+    state->reg_y = 0xff;
+    set_nz(state, state->reg_y);
+    rts(state);
+
+    /* LDY, JSR + 6 + RTS twice, 40 loops of 8, RTS */
+    return 1 + 8 + 8 + 40 * 8 + 1;
+}
+
+/* $e9c8, copies the screen line and color at SAL (line link in A)
+ * to the line at PNT, used when scrolling. */
+static int move_line(struct cpu_state *state)
+{
+    int y;
+
+    set(ZP_SAL + 1, (state->reg_a & 0x03) | get(ADDR_HIBASE));
+    set_color_pointer();
+    set(ZP_EAL, get(ZP_SAL));
+    set(ZP_EAL + 1, (get(ZP_SAL + 1) & 0x03) | 0xd8);
+    jsr_from(state, 0xe9cf);
+    state->sp -= 2;
+    jsr_from(state, 0xe9e0);
+    state->sp += 2;
+
+    for (y = 0x27; y >= 0; y--) {
+        set(indirect_y(ZP_PNT, y), get(indirect_y(ZP_SAL, y)));
+        state->reg_a = get(indirect_y(ZP_EAL, y));
+        set(indirect_y(ZP_USER, y), state->reg_a);
+    }
+
+    state->reg_y = 0xff;
+    set_nz(state, state->reg_y);
+    rts(state);
+
+    /* AND ORA STA JSR, JSR + 6 + RTS, 6 + RTS, LDY, 40 loops of 6,
+     * RTS */
+    return 4 + 8 + 7 + 1 + 40 * 6 + 1;
+}
+
+/* File name from SETNAM as host path, PETSCII upper case letters
+ * become lower case. */
+static void file_path(char *path, size_t size, const char *suffix)
+{
+    uint16_t name = get(ZP_FNADR) | get(ZP_FNADR + 1) << 8;
+    uint8_t  len  = get(ZP_FNLEN);
+    size_t   pos;
+    uint8_t  c;
+    int      i;
+
+    pos = snprintf(path, size, "%s/", _directory);
+    for (i = 0; i < len && pos < size - 1; i++) {
+        c = get(name + i);
+        if (c >= 'A' && c <= 'Z') {
+            c = c - 'A' + 'a';
+        }
+        else if (c == '/' || c < 0x20 || c > 0x7e) {
+            c = '_';
+        }
+        path[pos++] = c;
+    }
+    path[pos] = 0;
+    strncat(path, suffix, size - pos - 1);
+}
+
+static void return_error(struct cpu_state *state, uint8_t error)
+{
+    state->reg_a  = error;
+    state->flags |= FLAG_CARRY;
+    rts(state);
+}
+
+/* LOAD $f4a5 after the vector, A is 0 to load and 1 to verify */
+static int load(struct cpu_state *state)
+{
+    char     path[1024];
+    FILE     *f;
+    uint16_t address;
+    int      c;
+    uint8_t  status = STATUS_EOI;
+
+    if (get(ZP_FA) != DRIVE || get(ZP_FNLEN) == 0) {
+        return 0;
+    }
+    set(ZP_VERCK, state->reg_a);
+    set(ZP_STATUS, 0x00);
+
+    file_path(path, sizeof(path), "");
+    f = fopen(path, "rb");
+    if (!f) {
+        file_path(path, sizeof(path), ".prg");
+        f = fopen(path, "rb");
+    }
+    if (!f) {
+        TRACE0(_trace_trap, "load file not found");
+        return_error(state, ERROR_FILE_NOT_FOUND);
+        return 1;
+    }
+
+    address  = fgetc(f);
+    address |= fgetc(f) << 8;
+    /* Secondary address 0 loads to the address given to LOAD */
+    if (get(ZP_SA) == 0) {
+        address = get(ZP_MEMUSS) | get(ZP_MEMUSS + 1) << 8;
+    }
+    while ((c = fgetc(f)) != EOF) {
+        if (state->reg_a == 0) {
+            set(address, c);
+        }
+        else if (get(address) != c) {
+            status |= STATUS_VERIFY;
+        }
+        address++;
+    }
+    fclose(f);
+    TRACE(_trace_trap, "load end %04x", address);
+
+    set(ZP_STATUS, status);
+    set(ZP_EAL, address & 0xff);
+    set(ZP_EAL + 1, address >> 8);
+    state->reg_x  = address & 0xff;
+    state->reg_y  = address >> 8;
+    state->flags &= ~FLAG_CARRY;
+    rts(state);
+    return 1;
+}
+
+/* SAVE $f5ed after the vector, from STAL up to but not EAL */
+static int save(struct cpu_state *state)
+{
+    char     path[1024];
+    FILE     *f;
+    uint16_t start;
+    uint16_t end;
+    uint16_t address;
+
+    if (get(ZP_FA) != DRIVE || get(ZP_FNLEN) == 0) {
+        return 0;
+    }
+    start = get(ZP_STAL) | get(ZP_STAL + 1) << 8;
+    end   = get(ZP_EAL) | get(ZP_EAL + 1) << 8;
+
+    file_path(path, sizeof(path), ".prg");
+    f = fopen(path, "wb");
+    if (!f) {
+        TRACE0(_trace_trap, "save failed");
+        return_error(state, ERROR_FILE_NOT_FOUND);
+        return 1;
+    }
+    fputc(start & 0xff, f);
+    fputc(start >> 8, f);
+    for (address = start; address != end; address++) {
+        fputc(get(address), f);
+    }
+    fclose(f);
+    TRACE(_trace_trap, "save %04x-%04x", start, end);
+
+    set(ZP_STATUS, 0x00);
+    state->reg_a  = 0x00;
+    state->flags &= ~FLAG_CARRY;
+    rts(state);
+    return 1;
+}
+
+static struct trap _traps[] = {
+    { .name = "ramtas",     .address = 0xfd50, .handler = ramtas, },
+    { .name = "clear_line", .address = 0xe9ff, .handler = clear_line, },
+    { .name = "move_line",  .address = 0xe9c8, .handler = move_line, },
+    { .name = "load",       .address = 0xf4a5, .handler = load,
+      .drive = true, },
+    { .name = "save",       .address = 0xf5ed, .handler = save,
+      .drive = true, },
+};
+static const int _num_traps = sizeof(_traps) / sizeof(_traps[0]);
+
+static int handle(struct cpu_state *state)
+{
+    struct trap *trap = NULL;
+    int         executed;
+    int         i;
+
+    for (i = 0; i < _num_traps; i++) {
+        if (_traps[i].address == state->pc) {
+            trap = &_traps[i];
+            break;
+        }
+    }
+    if (!trap || (!trap->drive && !_acceleration)) {
+        return 0;
+    }
+    /* RAM or a cartridge may be mapped instead */
+    if (trap->address >= 0xe000 ? !pla_is_kernal_mapped() :
+                                  !pla_is_basic_mapped()) {
+        return 0;
+    }
+
+    executed = trap->handler(state);
+    if (executed) {
+        trap->hits++;
+        TRACE(_trace_trap, "%s replaced %d instructions",
+              trap->name, executed);
+    }
+    return executed;
+}
+
+void trap_init()
+{
+    int i;
+
+    cpu_set_trap_handler(handle);
+    _acceleration = true;
+    for (i = 0; i < _num_traps; i++) {
+        _traps[i].enabled = true;
+        _traps[i].hits    = 0;
+        cpu_set_trap(_traps[i].address, true);
+    }
+
+    _trace_trap = trace_add_point("TRAP", "trap");
+}
+
+bool trap_enable(const char *name, bool enable)
+{
+    bool all   = strcmp(name, "all") == 0;
+    bool found = false;
+    int  i;
+
+    for (i = 0; i < _num_traps; i++) {
+        if (all || strcmp(name, _traps[i].name) == 0) {
+            _traps[i].enabled = enable;
+            cpu_set_trap(_traps[i].address, enable);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void trap_set_acceleration(bool enable)
+{
+    _acceleration = enable;
+}
+
+bool trap_is_acceleration()
+{
+    return _acceleration;
+}
+
+void trap_set_directory(const char *dir)
+{
+    snprintf(_directory, sizeof(_directory), "%s", dir);
+}
+
+void trap_stat()
+{
+    int i;
+
+    printf("Directory: %s\n", _directory);
+    printf("Acceleration: %s\n", _acceleration ? "on" : "off");
+    for (i = 0; i < _num_traps; i++) {
+        printf("%-10s %04x %-3s %llu\n",
+               _traps[i].name, _traps[i].address,
+               _traps[i].enabled ? "on" : "off",
+               (unsigned long long)_traps[i].hits);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+
+/* Replaces hot KERNAL routines with native implementations.
+ *
+ * A trap is taken when the CPU is about to execute the first
+ * instruction of a routine while the ROM containing it is mapped.
+ * The routine is executed natively with the same register, flag,
+ * memory and stack side effects. The number of instructions it
+ * replaces is reported back so the rest of the machine is stepped
+ * exactly as far as it would have been.
+ *
+ * An interrupt raised while a trapped routine runs is taken when
+ * the routine has returned. Every trap can be turned off to compare
+ * results with the ROM code.
+ *
+ * LOAD and SAVE on device 8 read and write PRG files in a host
+ * directory, this replaces a disk drive rather than accelerating
+ * one, transfer time is not emulated. */
+
+void trap_init();
+
+/* Name of a trap or "all", false if there is no such trap */
+bool trap_enable(const char *name, bool enable);
+
+/* Traps replacing ROM code, all but LOAD and SAVE, are only taken
+ * while acceleration is on, whether enabled or not. A step of the
+ * machine then executes a single instruction, as without idle
+ * skipping. On after init. */
+void trap_set_acceleration(bool enable);
+bool trap_is_acceleration();
+
+/* Directory used by LOAD and SAVE on device 8 */
+void trap_set_directory(const char *dir);
+
+void trap_stat();
@@ -3,6 +3,8 @@
 #include <unistd.h>
 
 #include "trace.h"
+#include "coverage.h"
+#include "metrics.h"
 #include "vic.h"
 #include "snapshot.h"
 
@@ -27,7 +29,7 @@ static enum vic_bank _bank       = 0x00;
 static uint16_t _bank_offset     = 0x0000;
 static uint16_t _char_rom_offset = 0x0000;
 
-static uint8_t *_char_rom;
+static const uint8_t *_char_rom;
 static uint8_t *_ram;
 static uint8_t *_color_ram;
 
@@ -66,6 +68,8 @@ uint16_t _video_matrix_addr = 0x0000;
 static uint32_t *_screen;
 static uint32_t _pitch;
 static vic_refresh_hook _refresh_hook;
+/* Off for frames that are never shown */
+static bool _render = true;
 
 /* First/last line of drawable area.
  * Changed when toggling between 24/25 rows. */
@@ -81,10 +85,10 @@ uint16_t _curr_x        = 401;
 uint16_t _curr_fetching = 0;
 uint32_t *_curr_pixel;
 
-/* Filled during bad line */
-#define LINE_OFFSET 3
-uint8_t _curr_video_line[40+LINE_OFFSET];
-uint8_t _curr_color_line[40+LINE_OFFSET];
+/* Filled during bad line. Columns past the line are in the right
+ * border, not fetched */
+uint8_t _curr_video_line[VIC_LINE_COLUMNS];
+uint8_t _curr_color_line[VIC_LINE_COLUMNS];
 
 static bool _main_flip_flop;
 static bool _vert_flip_flop;
@@ -233,15 +237,15 @@ void vic_reset()
     _pixels              = 0;
     _color_fg            = 0;
 
-    memset(_curr_video_line, 0, 40+LINE_OFFSET);
-    memset(_curr_color_line, 0, 40+LINE_OFFSET);
+    memset(_curr_video_line, 0, VIC_LINE_COLUMNS);
+    memset(_curr_color_line, 0, VIC_LINE_COLUMNS);
     memset(_raw_regs, 0, 0x40);
 
     _setup_drawable_area();
     vic_set_bank(vic_bank_0);
 }
 
-void vic_init(uint8_t *char_rom,
+void vic_init(const uint8_t *char_rom,
               uint8_t *ram,
               uint8_t *color_ram)
 {
@@ -265,6 +269,11 @@ void vic_screen(uint32_t *screen, uint32_t pitch)
     _curr_pixel = _screen;
 }
 
+void vic_set_render(bool render)
+{
+    _render = render;
+}
+
 void vic_set_refresh_hook(vic_refresh_hook hook)
 {
     _refresh_hook = hook;
@@ -431,15 +440,19 @@ static void c_access()
 {
     uint8_t *from;
     uint16_t offset;
+    int      i;
 
     /* Video matrix / chars */
     offset = ((_curr_y - 0x30) >> 3) * 40;
     from = _ram + _bank_offset + _video_matrix_addr + offset;
-    memcpy(_curr_video_line+LINE_OFFSET, from, 40);
+    memcpy(_curr_video_line+VIC_LINE_OFFSET, from, 40);
+    for (i = 0; i < 40; i++) {
+        coverage_record(coverage_vic_badline, from - _ram + i);
+    }
 
     /* Color data */
     from = _color_ram + offset;
-    memcpy(_curr_color_line+LINE_OFFSET, from, 40);
+    memcpy(_curr_color_line+VIC_LINE_OFFSET, from, 40);
 }
 
 static inline void check_y()
@@ -473,47 +486,50 @@ static inline void check_x()
     }
 }
 
-static void draw_pixel_standard_text_mode()
+static void draw_pixel_standard_text_mode(bool render)
 {
-    if ((_curr_x & 0b111) == _scroll_x) {
+    if ((_curr_x & 0b111) == _scroll_x && _curr_x / 8 < VIC_LINE_COLUMNS) {
         /* G access */
         int      index  = _curr_x / 8;
         uint8_t  code   = _curr_video_line[index];
         int      line   = (_curr_y - _scroll_y) % 8;
         uint16_t offset = (code * (8)) + line;
-        uint8_t  color  = _curr_color_line[index] & 0x7f;
+        uint8_t  color  = _curr_color_line[index] & 0x0f;
         uint16_t addr   = _char_pixels_addr + offset;
 
         if (_char_rom_offset > 0 &&
             addr >= _char_rom_offset &&
             addr < _char_rom_offset + 0x1000) {
             _pixels = _char_rom[offset];
+            coverage_record(coverage_vic_graphics, _bank_offset + addr);
         }
         else {
             _pixels = _ram[offset];
+            coverage_record(coverage_vic_graphics, offset);
         }
         _color_fg = palette[color];
     }
     check_x();
-    if (_main_flip_flop || _vert_flip_flop) {
+    if (!render) {
+        /* Only the screen is left as it is */
+    }
+    else if (_main_flip_flop || _vert_flip_flop) {
         *_curr_pixel = _border_color;
     }
+    else if (_pixels & 0b10000000) {
+        *_curr_pixel = _color_fg;
+    }
     else {
-        if (_pixels & 0b10000000) {
-            *_curr_pixel = _color_fg;
-        }
-        else {
-            *_curr_pixel = _background_color0;
-        }
+        *_curr_pixel = _background_color0;
     }
     _pixels = _pixels << 1;
     _curr_pixel++;
     _curr_x++;
 }
 
-static void draw_pixel_standard_bitmap_mode()
+static void draw_pixel_standard_bitmap_mode(bool render)
 {
-    if ((_curr_x & 0b111) == _scroll_x) {
+    if ((_curr_x & 0b111) == _scroll_x && _curr_x / 8 < VIC_LINE_COLUMNS) {
         int      column = _curr_x / 8;
         int      row    = ((_curr_y - 0x30) >> 3);
         int      line   = (_curr_y - _scroll_y) % 8;
@@ -522,18 +538,20 @@ static void draw_pixel_standard_bitmap_mode()
 
         _pixels = _ram[addr];
         _color_fg = _curr_video_line[column];
+        coverage_record(coverage_vic_graphics, addr);
     }
     check_x();
-    if (_main_flip_flop || _vert_flip_flop) {
+    if (!render) {
+        /* Only the screen is left as it is */
+    }
+    else if (_main_flip_flop || _vert_flip_flop) {
         *_curr_pixel = _border_color;
     }
+    else if (_pixels & 0b10000000) {
+        *_curr_pixel = palette[(_color_fg >> 4) & 0x0f];
+    }
     else {
-        if (_pixels & 0b10000000) {
-            *_curr_pixel = palette[_color_fg >> 4];
-        }
-        else {
-            *_curr_pixel = palette[_color_fg & 0x7f];
-        }
+        *_curr_pixel = palette[_color_fg & 0x0f];
     }
     _pixels = _pixels << 1;
     _curr_pixel++;
@@ -555,12 +573,14 @@ void vic_step(int* skip, bool *stall_cpu)
         /* Filling lines */
         _curr_fetching--;
         *stall_cpu = true;
+        metrics.stalled_cycles++;
     }
     else if (_curr_cycle == 5 &&
         /* Need to start filling lines */
         _curr_y >= 0x30 && _curr_y <= 0xf7 &&
         ((_curr_y & 0b111) == _scroll_y)) {
         _curr_fetching = 40;
+        metrics.badlines++;
         c_access();
     }
 
@@ -572,10 +592,10 @@ void vic_step(int* skip, bool *stall_cpu)
 
         while (num--) {
             if (!_bitmap_graphics) {
-                draw_pixel_standard_text_mode();
+                draw_pixel_standard_text_mode(_render);
             }
             else {
-                draw_pixel_standard_bitmap_mode();
+                draw_pixel_standard_bitmap_mode(_render);
             }
         }
     }
@@ -599,6 +619,93 @@ void vic_step(int* skip, bool *stall_cpu)
     }
 }
 
+void vic_save_state(struct vic_saved_state *saved)
+{
+    saved->bank                = _bank;
+    saved->bank_offset         = _bank_offset;
+    saved->char_rom_offset     = _char_rom_offset;
+    saved->bitmap_graphics     = _bitmap_graphics;
+    saved->extended_color_text = _extended_color_text;
+    saved->display_enable      = _display_enable;
+    saved->multicolor          = _multicolor;
+    saved->columns_40          = _40_columns;
+    saved->rows_25             = _25_rows;
+    saved->reset               = _reset;
+    saved->scroll_y            = _scroll_y;
+    saved->scroll_x            = _scroll_x;
+    saved->raster_compare      = _raster_compare;
+    saved->interrupt_mask      = _interrupt_mask;
+    saved->interrupt_flag      = _interrupt_flag;
+    saved->border_color        = _border_color;
+    saved->background_color0   = _background_color0;
+    saved->background_color1   = _background_color1;
+    saved->background_color2   = _background_color2;
+    saved->char_pixels_addr    = _char_pixels_addr;
+    saved->bitmap_data_addr    = _bitmap_data_addr;
+    saved->video_matrix_addr   = _video_matrix_addr;
+    saved->top                 = _top;
+    saved->bottom              = _bottom;
+    saved->left                = _left;
+    saved->right               = _right;
+    saved->curr_y              = _curr_y;
+    saved->curr_x              = _curr_x;
+    saved->curr_fetching       = _curr_fetching;
+    saved->curr_pixel_offset   = (uint8_t*)_curr_pixel - (uint8_t*)_screen;
+    saved->main_flip_flop      = _main_flip_flop;
+    saved->vert_flip_flop      = _vert_flip_flop;
+    saved->curr_cycle          = _curr_cycle;
+    saved->pixels              = _pixels;
+    saved->color_fg            = _color_fg;
+
+    memcpy(saved->raw_regs, _raw_regs, 0x40);
+    memcpy(saved->curr_video_line, _curr_video_line, VIC_LINE_COLUMNS);
+    memcpy(saved->curr_color_line, _curr_color_line, VIC_LINE_COLUMNS);
+}
+
+void vic_restore_state(const struct vic_saved_state *saved)
+{
+    _bank                = saved->bank;
+    _bank_offset         = saved->bank_offset;
+    _char_rom_offset     = saved->char_rom_offset;
+    _bitmap_graphics     = saved->bitmap_graphics;
+    _extended_color_text = saved->extended_color_text;
+    _display_enable      = saved->display_enable;
+    _multicolor          = saved->multicolor;
+    _40_columns          = saved->columns_40;
+    _25_rows             = saved->rows_25;
+    _reset               = saved->reset;
+    _scroll_y            = saved->scroll_y;
+    _scroll_x            = saved->scroll_x;
+    _raster_compare      = saved->raster_compare;
+    _interrupt_mask      = saved->interrupt_mask;
+    _interrupt_flag      = saved->interrupt_flag;
+    _border_color        = saved->border_color;
+    _background_color0   = saved->background_color0;
+    _background_color1   = saved->background_color1;
+    _background_color2   = saved->background_color2;
+    _char_pixels_addr    = saved->char_pixels_addr;
+    _bitmap_data_addr    = saved->bitmap_data_addr;
+    _video_matrix_addr   = saved->video_matrix_addr;
+    _top                 = saved->top;
+    _bottom              = saved->bottom;
+    _left                = saved->left;
+    _right               = saved->right;
+    _curr_y              = saved->curr_y;
+    _curr_x              = saved->curr_x;
+    _curr_fetching       = saved->curr_fetching;
+    _curr_pixel          = (uint32_t*)((uint8_t*)_screen +
+                                       saved->curr_pixel_offset);
+    _main_flip_flop      = saved->main_flip_flop;
+    _vert_flip_flop      = saved->vert_flip_flop;
+    _curr_cycle          = saved->curr_cycle;
+    _pixels              = saved->pixels;
+    _color_fg            = saved->color_fg;
+
+    memcpy(_raw_regs, saved->raw_regs, 0x40);
+    memcpy(_curr_video_line, saved->curr_video_line, VIC_LINE_COLUMNS);
+    memcpy(_curr_color_line, saved->curr_color_line, VIC_LINE_COLUMNS);
+}
+
 void vic_snapshot(const char *name)
 {
     snap_screen(_screen, _pitch, 400, 400, name);
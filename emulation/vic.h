@@ -22,17 +22,25 @@
 #define VIC_SCROLY_ROW_25       0b00001000
 #define VIC_SCROLY_SCROLL       0b00000111
 
+/* Video and color line, fetched from the offset on */
+#define VIC_LINE_OFFSET  3
+#define VIC_LINE_COLUMNS (40+VIC_LINE_OFFSET)
+
 /* VMCSB masks */
 #define VIC_VMCSB_CHAR_PIX_ADDR 0b00001110
 #define VIC_VMCSB_VID_MATR_ADDR 0b11110000
 
 typedef void (*vic_refresh_hook)();
 
-void vic_init(uint8_t *char_rom,
+void vic_init(const uint8_t *char_rom,
               uint8_t *ram,
               uint8_t *color_ram);
 
 void vic_screen(uint32_t *screen, uint32_t pitch);
+
+/* Nothing is written to the screen when off, the beam, border and
+ * graphics still run as they would. On by default. */
+void vic_set_render(bool render);
 void vic_set_refresh_hook(vic_refresh_hook refresh_hook);
 
 void vic_reset();
@@ -57,5 +65,59 @@ enum vic_bank vic_get_bank();
 
 void vic_step(int *skip, bool *stall_cpu);
 
+/* Registers and beam position for save states, the screen being
+ * rendered to is not part of it. */
+struct vic_saved_state {
+    enum vic_bank bank;
+    uint16_t      bank_offset;
+    uint16_t      char_rom_offset;
+
+    bool bitmap_graphics;
+    bool extended_color_text;
+    bool display_enable;
+    bool multicolor;
+    bool columns_40;
+    bool rows_25;
+    bool reset;
+
+    uint8_t  scroll_y;
+    uint8_t  scroll_x;
+    uint16_t raster_compare;
+    uint8_t  interrupt_mask;
+    uint8_t  interrupt_flag;
+
+    uint32_t border_color;
+    uint32_t background_color0;
+    uint32_t background_color1;
+    uint32_t background_color2;
+
+    uint8_t  raw_regs[0x40];
+    uint16_t char_pixels_addr;
+    uint16_t bitmap_data_addr;
+    uint16_t video_matrix_addr;
+
+    uint16_t top;
+    uint16_t bottom;
+    uint16_t left;
+    uint16_t right;
+
+    uint16_t curr_y;
+    uint16_t curr_x;
+    uint16_t curr_fetching;
+    /* Byte offset of current pixel within screen */
+    uint32_t curr_pixel_offset;
+    uint8_t  curr_video_line[VIC_LINE_COLUMNS];
+    uint8_t  curr_color_line[VIC_LINE_COLUMNS];
+
+    bool     main_flip_flop;
+    bool     vert_flip_flop;
+    int      curr_cycle;
+    uint8_t  pixels;
+    uint32_t color_fg;
+};
+
+void vic_save_state(struct vic_saved_state *saved);
+void vic_restore_state(const struct vic_saved_state *saved);
+
 void vic_stat();
 void vic_snapshot(const char *name);
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "emulation/c64.h"
+#include "emulation/trap.h"
+
+#include "infrastructure/speed.h"
+#include "infrastructure/perf.h"
+
+#include "ui/headless_c64.h"
+
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options]\n"
+           "  -r <dir>    Directory with ROM images\n"
+           "  -p <file>   PRG to load when BASIC is ready\n"
+           "  -B <file>   Cache state at READY in file\n"
+           "  -I <file>   Replay input log, until its end\n"
+           "  -d <dir>    Directory served as device 8\n"
+           "  -n <trap>   Turn off KERNAL trap, 'all' for every trap\n"
+           "  -f <num>    Run number of frames\n"
+           "  -c <num>    Run number of cycles\n"
+           "  -b <addr>   Run until PC reaches address (hex)\n"
+           "  -X          Stop exactly, execute ROM routines not trapped\n"
+           "  -V          Validate fast paths against every step\n"
+           "  -s <file>   Write screenshot as PNG\n"
+           "  -m <file>   Write RAM dump\n"
+           "  -t <file>   Write timing statistics, default stdout\n"
+           "  -x <file>   Record binary execution trace\n"
+           "  -P <file>   Write host time per subsystem and frame\n"
+           "  -M <file>   Write device counters as JSON lines\n"
+           "  -e <num>    Frames between device counter lines, default 50\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    struct headless_options options = { .metrics_period = 50 };
+    const char              *rom_dir = NULL;
+    const char              *drive_dir = NULL;
+    const char              *traps_off[16];
+    int                     num_traps_off = 0;
+    int                     opt;
+    int                     i;
+
+    while ((opt = getopt(argc, argv, "r:p:B:I:d:n:f:c:b:XVs:m:t:x:P:M:e:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            rom_dir = optarg;
+            break;
+        case 'p':
+            options.prg = optarg;
+            break;
+        case 'B':
+            options.boot_cache = optarg;
+            break;
+        case 'I':
+            options.replay = optarg;
+            break;
+        case 'd':
+            drive_dir = optarg;
+            break;
+        case 'n':
+            if (num_traps_off < 16) {
+                traps_off[num_traps_off++] = optarg;
+            }
+            break;
+        case 'f':
+            options.frames = strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            options.cycles = strtoull(optarg, NULL, 10);
+            break;
+        case 'b':
+            options.break_on_pc = true;
+            options.break_pc    = strtol(optarg, NULL, 16);
+            break;
+        case 'X':
+            options.exact = true;
+            break;
+        case 'V':
+            options.shadow = true;
+            break;
+        case 's':
+            options.screenshot = optarg;
+            break;
+        case 'm':
+            options.ram_dump = optarg;
+            break;
+        case 't':
+            options.stats = optarg;
+            break;
+        case 'x':
+            options.trace = optarg;
+            break;
+        case 'P':
+            options.perf_dump = optarg;
+            break;
+        case 'M':
+            options.metrics_dump = optarg;
+            break;
+        case 'e':
+            options.metrics_period = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!options.frames && !options.cycles && !options.break_on_pc &&
+        !options.replay) {
+        printf("Nothing to stop at, specify frames, cycles or PC\n");
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (c64_init(rom_dir) != 0) {
+        return -1;
+    }
+    if (drive_dir) {
+        trap_set_directory(drive_dir);
+    }
+    for (i = 0; i < num_traps_off; i++) {
+        if (!trap_enable(traps_off[i], false)) {
+            printf("No trap named %s\n", traps_off[i]);
+            return -1;
+        }
+    }
+    speed_init(C64_CLOCK_HZ);
+    perf_init();
+
+    return headless_c64_run(&options, NULL);
+}
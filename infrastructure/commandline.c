@@ -10,14 +10,26 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include "c64.h"
 #include "mem.h"
 #include "cpu.h"
+#include "cpu_calls.h"
 #include "trace.h"
+#include "perf.h"
+#include "metrics.h"
 #include "commandline.h"
 #include "basic.h"
 #include "vic.h"
 #include "pla.h"
+#include "savestate.h"
+#include "rewind.h"
+#include "input.h"
+#include "reverse.h"
 #include "command.h"
+#include "coverage.h"
+#include "snapshot.h"
+#include "speed.h"
+#include "trap.h"
 
 static int  _log_fd;
 static bool _exit_loop;
@@ -38,7 +50,7 @@ struct command {
 
 static void set_vic_reg(uint16_t reg, uint8_t val)
 {
-    vic_reg_set(val, 0xd000 + reg, NULL);
+    input_vic_reg_set(reg, val);
 }
 
 static uint8_t get_vic_reg(uint16_t reg)
@@ -81,6 +93,11 @@ static void on_trace()
         bool turn_on = strcmp(token, "on") == 0;
         int  fd      = turn_on ? _log_fd : -1;
 
+        /* Recorded instead of written while there is a binary trace */
+        if (turn_on && trace_binary_is_open()) {
+            fd = TRACE_FD_BINARY;
+        }
+
         p = trace_enum_points(NULL);
         while (p) {
             /* When sys is not specified all traces will be
@@ -89,7 +106,7 @@ static void on_trace()
                 /* When name not specified all traces that matches
                  * sys will be turned on/off. */
                 if (name == NULL || strcmp(p->name, name) == 0) {
-                    p->fd = fd;
+                    trace_set_fd(p, fd);
                 }
             }
             p = trace_enum_points(p);
@@ -97,6 +114,24 @@ static void on_trace()
         return;
     }
 
+    /* Binary trace that points turned on are recorded to */
+    if (strcmp(token, "record") == 0) {
+        char *path = strtok(NULL, " ");
+
+        if (!path) {
+            trace_binary_stat();
+            return;
+        }
+        if (strcmp(path, "off") == 0) {
+            trace_binary_close();
+            return;
+        }
+        if (!trace_binary_open(path)) {
+            printf("Failed to open %s\n", path);
+        }
+        return;
+    }
+
     printf("Unknown trace parameter\n");
 }
 
@@ -151,12 +186,9 @@ static void on_color_ram()
             if (token) {
                 cmd_parse_uint16(token, &num);
             }
-            ram += addr;
             printf("Setting %04x num %02x to %02x\n",
                     addr, num, val);
-            for (int i = 0; i < num; i++) {
-                ram[i] = val;
-            }
+            input_color_ram_fill(addr, val, num);
             return;
         }
         else {
@@ -256,36 +288,180 @@ static void on_pla()
 static void on_load()
 {
     char     *token = strtok(NULL, " ");
-    FILE     *f;
-    size_t   size;
-    uint8_t  buf[0xffff];
     uint16_t start;
-    uint8_t  *ram;
+    uint16_t size;
 
     if (!token) {
         printf("Missing filepath to PRG\n");
         return;
     }
 
-    f = fopen(token, "rb");
-    if (!f) {
-        printf("Failed to open %s\n", token);
-        return;
-    }
     printf("Loading %s...\n", token);
-    size = fread(buf, 1, 0xffff, f);
-    if (size <= 1) {
-        printf("Failed to read\n");
+    if (input_load_prg(token, &start, &size) != 0) {
+        printf("Failed to load %s\n", token);
         return;
     }
-    start = (buf[1] << 8) | buf[0];
     printf("Loaded %04x bytes program starts "
-           "at %04x\n", (uint16_t)size, start);
-    ram = mem_get_ram(start);
-    if (!ram) {
+           "at %04x\n", size, start);
+}
+
+static void on_save()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        printf("Missing filepath to save state to\n");
         return;
     }
-    memcpy(ram, buf + 2, size - 2);
+    if (!savestate_save(token)) {
+        printf("Failed to save state to %s\n", token);
+        return;
+    }
+    printf("Saved state to %s\n", token);
+}
+
+static void on_restore()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        printf("Missing filepath to restore state from\n");
+        return;
+    }
+    if (!input_restore_state(token)) {
+        printf("Failed to restore state from %s\n", token);
+        return;
+    }
+    printf("Restored state from %s\n", token);
+}
+
+static void on_rewind()
+{
+    char     *token = strtok(NULL, " ");
+    char     *value;
+    uint32_t steps  = 1;
+    uint32_t i;
+
+    if (!token) {
+        rewind_stat();
+        return;
+    }
+    if (strcmp(token, "on") == 0 || strcmp(token, "off") == 0) {
+        if (!rewind_enable(strcmp(token, "on") == 0)) {
+            printf("Out of memory\n");
+        }
+        return;
+    }
+    /* Number of snapshots, one by default */
+    if (strcmp(token, "back") == 0) {
+        value = strtok(NULL, " ");
+        if (value) {
+            steps = strtoul(value, NULL, 10);
+        }
+        for (i = 0; i < steps; i++) {
+            if (!input_rewind_back()) {
+                break;
+            }
+        }
+        printf("Stepped back %u snapshots to frame %llu\n", i,
+               (unsigned long long)c64_frames());
+        return;
+    }
+    if (strcmp(token, "period") == 0 || strcmp(token, "budget") == 0) {
+        value = strtok(NULL, " ");
+        if (!value) {
+            printf("Usage: rewind period <frames>|budget <MB>\n");
+            return;
+        }
+        if (strcmp(token, "period") == 0) {
+            rewind_set_period(strtoul(value, NULL, 10));
+        }
+        else {
+            rewind_set_budget((size_t)strtoul(value, NULL, 10) << 20);
+        }
+        return;
+    }
+    printf("Unknown rewind parameter\n");
+}
+
+static void on_input()
+{
+    char *token = strtok(NULL, " ");
+    char *path;
+
+    if (!token) {
+        input_stat();
+        return;
+    }
+    if (strcmp(token, "stop") == 0) {
+        input_stop();
+        return;
+    }
+    if (strcmp(token, "record") == 0 || strcmp(token, "replay") == 0) {
+        path = strtok(NULL, " ");
+        if (!path) {
+            printf("Usage: input record|replay <file>\n");
+            return;
+        }
+        if (strcmp(token, "record") == 0) {
+            if (!input_record(path)) {
+                printf("Failed to record to %s\n", path);
+            }
+        }
+        else if (!input_replay(path)) {
+            printf("Failed to replay %s\n", path);
+        }
+        return;
+    }
+    printf("Unknown input parameter\n");
+}
+
+/* Where reverse execution went */
+static void print_position()
+{
+    struct cpu_state state;
+    uint16_t         next;
+
+    cpu_get_state(&state);
+    printf("Instruction %llu in frame %llu\n",
+           (unsigned long long)state.instructions,
+           (unsigned long long)c64_frames());
+    cpu_disassembly_at(STDOUT_FILENO, state.pc, 1, &next);
+}
+
+static void on_reverse_step()
+{
+    char     *token = strtok(NULL, " ");
+    uint64_t num    = 1;
+
+    if (token) {
+        num = strtoull(token, NULL, 10);
+    }
+    if (!reverse_step(num)) {
+        printf("Cannot go back %llu instructions\n",
+               (unsigned long long)num);
+        return;
+    }
+    print_position();
+}
+
+static void on_back()
+{
+    char     *token = strtok(NULL, " ");
+    uint16_t addr;
+
+    if (!token) {
+        printf("Usage: back <address>\n");
+        return;
+    }
+    if (!cmd_parse_address(token, &addr)) {
+        return;
+    }
+    if (!reverse_to_write(addr)) {
+        printf("No write to %04x in the history\n", addr);
+        return;
+    }
+    print_position();
 }
 
 static void on_dis()
@@ -313,6 +489,387 @@ static void xon_exit()
     *_exit_app = true;
 }
 
+static void on_warp()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        speed_set_warp(!speed_is_warp());
+    }
+    else if (strcmp(token, "on") == 0) {
+        speed_set_warp(true);
+    }
+    else if (strcmp(token, "off") == 0) {
+        speed_set_warp(false);
+    }
+    else {
+        printf("Unknown warp parameter\n");
+        return;
+    }
+    printf("Warp %s\n", speed_is_warp() ? "on" : "off");
+}
+
+static void on_speed()
+{
+    speed_stat();
+}
+
+static void on_perf()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        perf_stat();
+        return;
+    }
+    if (strcmp(token, "on") == 0 || strcmp(token, "off") == 0) {
+        if (!perf_enable(strcmp(token, "on") == 0)) {
+            printf("Accounting is compiled out\n");
+        }
+        return;
+    }
+    if (strcmp(token, "reset") == 0) {
+        perf_reset();
+        return;
+    }
+    /* JSON line every number of frames, default every second */
+    if (strcmp(token, "dump") == 0) {
+        char *path   = strtok(NULL, " ");
+        char *frames = strtok(NULL, " ");
+
+        if (!path) {
+            printf("Usage: perf dump <file> [frames]|off\n");
+            return;
+        }
+        if (strcmp(path, "off") == 0) {
+            perf_set_dump(NULL, 0);
+            return;
+        }
+        if (!perf_set_dump(path, frames ? strtoul(frames, NULL, 10) : 50)) {
+            printf("Failed to open %s\n", path);
+        }
+        return;
+    }
+    printf("Unknown perf parameter\n");
+}
+
+static void on_stats()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        metrics_stat();
+        return;
+    }
+    if (strcmp(token, "reset") == 0) {
+        metrics_reset();
+        return;
+    }
+    /* JSON line every number of frames, default every second */
+    if (strcmp(token, "dump") == 0) {
+        char *path   = strtok(NULL, " ");
+        char *frames = strtok(NULL, " ");
+
+        if (!path) {
+            printf("Usage: stats dump <file> [frames]|off\n");
+            return;
+        }
+        if (strcmp(path, "off") == 0) {
+            metrics_set_dump(NULL, 0);
+            return;
+        }
+        if (!metrics_set_dump(path,
+                              frames ? strtoul(frames, NULL, 10) : 50)) {
+            printf("Failed to open %s\n", path);
+        }
+        return;
+    }
+    printf("Unknown stats parameter\n");
+}
+
+static const struct cpu_profile_entry *_sort_profile;
+
+/* Most cycles first */
+static int compare_profile(const void *a, const void *b)
+{
+    const struct cpu_profile_entry *pa = &_sort_profile[*(uint16_t*)a];
+    const struct cpu_profile_entry *pb = &_sort_profile[*(uint16_t*)b];
+
+    if (pa->cycles != pb->cycles) {
+        return pa->cycles < pb->cycles ? 1 : -1;
+    }
+    if (pa->instructions != pb->instructions) {
+        return pa->instructions < pb->instructions ? 1 : -1;
+    }
+    return 0;
+}
+
+/* Writes the top number of addresses, all when 0, with the
+ * instruction at each. */
+static void write_profile(int fd, int top)
+{
+    static uint16_t                addresses[65536];
+    const struct cpu_profile_entry *profile = cpu_profile();
+    uint64_t                       cycles = 0;
+    uint16_t                       next;
+    int                            num = 0;
+    int                            i;
+
+    for (i = 0; i < 65536; i++) {
+        if (profile[i].instructions) {
+            addresses[num++] = i;
+            cycles += profile[i].cycles;
+        }
+    }
+    _sort_profile = profile;
+    qsort(addresses, num, sizeof(addresses[0]), compare_profile);
+    if (top && top < num) {
+        num = top;
+    }
+
+    dprintf(fd, "%14s %14s %6s\n", "Instructions", "Cycles", "Share");
+    for (i = 0; i < num; i++) {
+        dprintf(fd, "%14llu %14llu %5.1f%% ",
+                (unsigned long long)profile[addresses[i]].instructions,
+                (unsigned long long)profile[addresses[i]].cycles,
+                cycles ? 100.0 * profile[addresses[i]].cycles / cycles : 0);
+        cpu_disassembly_at(fd, addresses[i], 1, &next);
+    }
+}
+
+/* Routines with most cycles including what they called */
+static void write_calls(int top)
+{
+    struct cpu_calls_routine *routines = malloc(top * sizeof(*routines));
+    int                      num;
+    int                      i;
+
+    if (!routines) {
+        return;
+    }
+    num = cpu_calls_routines(routines, top);
+
+    printf("%-9s %10s %14s %14s\n",
+           "Routine", "Calls", "Inclusive", "Exclusive");
+    for (i = 0; i < num; i++) {
+        printf("%s$%04x %10llu %14llu %14llu\n",
+               routines[i].interrupt ? "IRQ " : "    ",
+               routines[i].address,
+               (unsigned long long)routines[i].calls,
+               (unsigned long long)routines[i].inclusive,
+               (unsigned long long)routines[i].exclusive);
+    }
+    free(routines);
+}
+
+static void on_profile_calls()
+{
+    char *token = strtok(NULL, " ");
+    char *path;
+    int  fd;
+
+    if (token && strcmp(token, "on") == 0) {
+        cpu_set_call_graph(true);
+        return;
+    }
+    if (token && strcmp(token, "off") == 0) {
+        cpu_set_call_graph(false);
+        return;
+    }
+    /* Folded stacks for flame graph tools */
+    if (token && strcmp(token, "save") == 0) {
+        path = strtok(NULL, " ");
+        if (!path) {
+            printf("Usage: profile calls save <file>\n");
+            return;
+        }
+        fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+        if (fd == -1) {
+            printf("Failed to open %s\n", path);
+            return;
+        }
+        cpu_calls_write_folded(fd);
+        close(fd);
+        return;
+    }
+    write_calls(token && atoi(token) > 0 ? atoi(token) : 20);
+}
+
+static void on_profile()
+{
+    char *token = strtok(NULL, " ");
+    char *path;
+    int  fd;
+
+    if (token && strcmp(token, "calls") == 0) {
+        on_profile_calls();
+        return;
+    }
+    if (token && strcmp(token, "on") == 0) {
+        if (!cpu_set_profile(true)) {
+            printf("Out of memory\n");
+        }
+        return;
+    }
+    if (token && strcmp(token, "off") == 0) {
+        cpu_set_profile(false);
+        return;
+    }
+    if (token && strcmp(token, "reset") == 0) {
+        cpu_profile_reset();
+        if (cpu_is_call_graph()) {
+            cpu_calls_reset();
+        }
+        return;
+    }
+    if (!cpu_is_profile()) {
+        printf("Profiling is off, turn on with 'profile on'\n");
+        return;
+    }
+    if (!token) {
+        write_profile(STDOUT_FILENO, 20);
+        return;
+    }
+    if (strcmp(token, "top") == 0) {
+        token = strtok(NULL, " ");
+        write_profile(STDOUT_FILENO, token ? atoi(token) : 20);
+        return;
+    }
+    /* Every address executed */
+    if (strcmp(token, "save") == 0) {
+        path = strtok(NULL, " ");
+        if (!path) {
+            printf("Usage: profile save <file>\n");
+            return;
+        }
+        fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+        if (fd == -1) {
+            printf("Failed to open %s\n", path);
+            return;
+        }
+        write_profile(fd, 0);
+        close(fd);
+        return;
+    }
+    printf("Unknown profile parameter\n");
+}
+
+static void on_coverage()
+{
+    char     *token = strtok(NULL, " ");
+    char     *path  = token ? strtok(NULL, " ") : NULL;
+    uint32_t *pixels;
+
+    if (!token) {
+        coverage_stat();
+        return;
+    }
+    if (strcmp(token, "on") == 0 || strcmp(token, "off") == 0) {
+        if (!c64_set_coverage(strcmp(token, "on") == 0)) {
+            printf("Out of memory\n");
+        }
+        return;
+    }
+    if (strcmp(token, "reset") == 0) {
+        coverage_reset();
+        return;
+    }
+    if (!path) {
+        printf("Usage: coverage [on|off|reset|png <file>|raw <file>]\n");
+        return;
+    }
+    /* A pixel per address, a row per page */
+    if (strcmp(token, "png") == 0) {
+        pixels = malloc(256 * 256 * sizeof(*pixels));
+        if (!pixels) {
+            return;
+        }
+        coverage_heatmap(pixels);
+        snap_screen(pixels, 256 * sizeof(*pixels), 256, 256, path);
+        free(pixels);
+        return;
+    }
+    if (strcmp(token, "raw") == 0) {
+        if (!coverage_save_raw(path)) {
+            printf("Failed to write %s\n", path);
+        }
+        return;
+    }
+    printf("Unknown coverage parameter\n");
+}
+
+static void on_idle()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        c64_set_idle_skip(!c64_is_idle_skip());
+    }
+    else if (strcmp(token, "on") == 0) {
+        c64_set_idle_skip(true);
+    }
+    else if (strcmp(token, "off") == 0) {
+        c64_set_idle_skip(false);
+    }
+    else {
+        printf("Unknown idle parameter\n");
+        return;
+    }
+    printf("Idle loop skipping %s\n", c64_is_idle_skip() ? "on" : "off");
+}
+
+static void on_shadow()
+{
+    char *token = strtok(NULL, " ");
+
+    if (!token) {
+        token = c64_is_shadow() ? "off" : "on";
+    }
+    if (strcmp(token, "on") != 0 && strcmp(token, "off") != 0) {
+        printf("Unknown shadow parameter\n");
+        return;
+    }
+    if (!c64_set_shadow(strcmp(token, "on") == 0)) {
+        printf("Out of memory\n");
+        return;
+    }
+    printf("Shadow execution %s\n", c64_is_shadow() ? "on" : "off");
+}
+
+static void on_run_ahead()
+{
+    char *token = strtok(NULL, " ");
+
+    if (token) {
+        if (strcmp(token, "off") == 0) {
+            c64_set_run_ahead(0);
+        }
+        else if (!c64_set_run_ahead(strtol(token, NULL, 10))) {
+            printf("Out of memory\n");
+        }
+    }
+    printf("Run ahead %d frames\n", c64_get_run_ahead());
+}
+
+static void on_trap()
+{
+    char *name  = strtok(NULL, " ");
+    char *state = strtok(NULL, " ");
+
+    if (!name) {
+        trap_stat();
+        return;
+    }
+    if (!state || (strcmp(state, "on") != 0 &&
+                   strcmp(state, "off") != 0)) {
+        printf("Usage: trap [<name>|all on|off]\n");
+        return;
+    }
+    if (!trap_enable(name, strcmp(state, "on") == 0)) {
+        printf("No trap named %s\n", name);
+    }
+}
+
 static void on_basic()
 {
     basic_stat(STDOUT_FILENO);
@@ -362,6 +919,70 @@ struct command _commands[] = {
         .name        = "load",
         .handler     = on_load,
     },
+    {
+        .name        = "save",
+        .handler     = on_save,
+    },
+    {
+        .name        = "restore",
+        .handler     = on_restore,
+    },
+    {
+        .name        = "rewind",
+        .handler     = on_rewind,
+    },
+    {
+        .name        = "back",
+        .handler     = on_back,
+    },
+    {
+        .name        = "reverse-step",
+        .handler     = on_reverse_step,
+    },
+    {
+        .name        = "input",
+        .handler     = on_input,
+    },
+    {
+        .name        = "warp",
+        .handler     = on_warp,
+    },
+    {
+        .name        = "speed",
+        .handler     = on_speed,
+    },
+    {
+        .name        = "trap",
+        .handler     = on_trap,
+    },
+    {
+        .name        = "idle",
+        .handler     = on_idle,
+    },
+    {
+        .name        = "shadow",
+        .handler     = on_shadow,
+    },
+    {
+        .name        = "runahead",
+        .handler     = on_run_ahead,
+    },
+    {
+        .name        = "perf",
+        .handler     = on_perf,
+    },
+    {
+        .name        = "stats",
+        .handler     = on_stats,
+    },
+    {
+        .name        = "profile",
+        .handler     = on_profile,
+    },
+    {
+        .name        = "coverage",
+        .handler     = on_coverage,
+    },
     {
         .name        = "help",
         .alternative = "?",
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+
+static const char *_hooks_names[metrics_num_hooks] = {
+    [metrics_hooks_other]     = "other",
+    [metrics_hooks_rom]       = "rom",
+    [metrics_hooks_vic]       = "vic",
+    [metrics_hooks_sid]       = "sid",
+    [metrics_hooks_color_ram] = "color_ram",
+    [metrics_hooks_cia1]      = "cia1",
+    [metrics_hooks_cia2]      = "cia2",
+};
+
+struct metrics metrics;
+
+/* Periodic dump */
+static FILE     *_dump;
+static uint32_t _dump_period;
+static uint32_t _dump_frames;
+
+static void write_dump()
+{
+    int i;
+
+    fprintf(_dump,
+            "{\"frames\":%llu,\"frames_skipped\":%llu,\"cycles\":%llu,"
+            "\"instructions\":%llu,\"irqs_taken\":%llu,"
+            "\"irqs_denied\":%llu,\"badlines\":%llu,"
+            "\"stalled_cycles\":%llu,\"pla_configs\":%llu",
+            (unsigned long long)metrics.frames,
+            (unsigned long long)metrics.frames_skipped,
+            (unsigned long long)metrics.cycles,
+            (unsigned long long)metrics.instructions,
+            (unsigned long long)metrics.irqs_taken,
+            (unsigned long long)metrics.irqs_denied,
+            (unsigned long long)metrics.badlines,
+            (unsigned long long)metrics.stalled_cycles,
+            (unsigned long long)metrics.pla_configs);
+    for (i = 0; i < metrics_num_hooks; i++) {
+        fprintf(_dump, ",\"hooks_%s\":%llu", _hooks_names[i],
+                (unsigned long long)metrics.hook_calls[i]);
+    }
+    fprintf(_dump, "}\n");
+    fflush(_dump);
+}
+
+void metrics_init()
+{
+    _dump = NULL;
+    metrics_reset();
+}
+
+void metrics_reset()
+{
+    memset(&metrics, 0, sizeof(metrics));
+    _dump_frames = 0;
+}
+
+void metrics_frame()
+{
+    metrics.frames++;
+    if (_dump && ++_dump_frames >= _dump_period) {
+        write_dump();
+        _dump_frames = 0;
+    }
+}
+
+bool metrics_set_dump(const char *path, uint32_t period)
+{
+    if (_dump) {
+        fclose(_dump);
+        _dump = NULL;
+    }
+    if (!path) {
+        return true;
+    }
+    _dump = fopen(path, "w");
+    if (!_dump) {
+        return false;
+    }
+    _dump_period = period ? period : 1;
+    _dump_frames = 0;
+    return true;
+}
+
+const char *metrics_hooks_name(enum metrics_hooks hooks)
+{
+    return _hooks_names[hooks];
+}
+
+void metrics_stat()
+{
+    int i;
+
+    printf("Frames         : %llu\n", (unsigned long long)metrics.frames);
+    printf("Frames skipped : %llu\n",
+           (unsigned long long)metrics.frames_skipped);
+    printf("Cycles         : %llu\n", (unsigned long long)metrics.cycles);
+    printf("Instructions   : %llu\n",
+           (unsigned long long)metrics.instructions);
+    printf("IRQs taken     : %llu\n",
+           (unsigned long long)metrics.irqs_taken);
+    printf("IRQs denied    : %llu\n",
+           (unsigned long long)metrics.irqs_denied);
+    printf("Bad lines      : %llu\n", (unsigned long long)metrics.badlines);
+    printf("Stalled cycles : %llu\n",
+           (unsigned long long)metrics.stalled_cycles);
+    printf("PLA configs    : %llu\n",
+           (unsigned long long)metrics.pla_configs);
+    printf("Memory hooks called\n");
+    for (i = 0; i < metrics_num_hooks; i++) {
+        printf("%-14s : %llu\n", _hooks_names[i],
+               (unsigned long long)metrics.hook_calls[i]);
+    }
+}
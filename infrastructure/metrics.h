@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Counters of what the emulated devices do, for dashboards and
+ * regression checks. Always on, each is a plain increment where the
+ * event happens. Counted since init or the last reset. */
+
+/* Whose memory hooks the CPU called */
+enum metrics_hooks {
+    /* CPU port and anything installed without an owner */
+    metrics_hooks_other,
+    metrics_hooks_rom,
+    metrics_hooks_vic,
+    metrics_hooks_sid,
+    metrics_hooks_color_ram,
+    metrics_hooks_cia1,
+    metrics_hooks_cia2,
+    metrics_num_hooks
+};
+
+struct metrics {
+    uint64_t cycles;
+    /* Including those run by traps, accelerated or skipped */
+    uint64_t instructions;
+    uint64_t irqs_taken;
+    /* Requested while interrupts were disabled, the request is
+     * repeated every cycle until the interrupt is acknowledged */
+    uint64_t irqs_denied;
+    uint64_t badlines;
+    /* Cycles the CPU was stalled by the VIC */
+    uint64_t stalled_cycles;
+    /* CPU port changes forwarded to the PLA */
+    uint64_t pla_configs;
+    /* By instructions executed, not by those in skipped idle loops */
+    uint64_t hook_calls[metrics_num_hooks];
+    /* Completed by the VIC */
+    uint64_t frames;
+    /* Completed but not presented by the front end */
+    uint64_t frames_skipped;
+};
+
+extern struct metrics metrics;
+
+void metrics_init();
+void metrics_reset();
+
+/* Call when a frame is complete */
+void metrics_frame();
+
+/* Writes a JSON line with all counters every period frames to path,
+ * NULL to stop. */
+bool metrics_set_dump(const char *path, uint32_t period);
+
+const char *metrics_hooks_name(enum metrics_hooks hooks);
+void metrics_stat();
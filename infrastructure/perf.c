@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "perf.h"
+
+/* Counters are opened as a group and read in one go */
+struct counter_group {
+    uint64_t nr;
+    uint64_t values[perf_num_counters];
+};
+
+#ifndef C64_NO_PERF
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} _counter_events[perf_num_counters] = {
+    [perf_instructions]  = { PERF_TYPE_HARDWARE,
+                             PERF_COUNT_HW_INSTRUCTIONS },
+    [perf_cache_misses]  = { PERF_TYPE_HARDWARE,
+                             PERF_COUNT_HW_CACHE_MISSES },
+    [perf_branch_misses] = { PERF_TYPE_HARDWARE,
+                             PERF_COUNT_HW_BRANCH_MISSES },
+};
+#endif
+
+static const char *_subsystem_names[perf_num_subsystems] = {
+    [perf_other]     = "other",
+    [perf_cpu]       = "cpu",
+    [perf_mem_hooks] = "mem_hooks",
+    [perf_vic]       = "vic",
+    [perf_cia]       = "cia",
+    [perf_frontend]  = "frontend",
+    [perf_throttle]  = "throttle",
+};
+
+static const char *_counter_names[perf_num_counters] = {
+    [perf_instructions]  = "instructions",
+    [perf_cache_misses]  = "cache_misses",
+    [perf_branch_misses] = "branch_misses",
+};
+
+bool perf_enabled;
+
+/* Ticks of the running frame */
+static enum perf_subsystem _current;
+static uint64_t            _last_tick;
+static uint64_t            _ticks[perf_num_subsystems];
+
+/* Ticks are converted to ns by comparing with the clock since this
+ * point, the time stamp counter rate is not known up front. */
+static uint64_t _calibration_tick;
+static int64_t  _calibration_ns;
+
+static int      _counter_fds[perf_num_counters];
+static uint64_t _counters_at_frame[perf_num_counters];
+
+static struct perf_frame _last;
+static struct perf_frame _total;
+static uint64_t          _frames;
+
+/* Periodic dump */
+static FILE              *_dump;
+static uint32_t          _dump_period;
+static struct perf_frame _dump_sum;
+static uint32_t          _dump_frames;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline uint64_t now_tick()
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+enum perf_subsystem perf_account(enum perf_subsystem to)
+{
+    uint64_t            now  = now_tick();
+    enum perf_subsystem from = _current;
+
+    _ticks[from] += now - _last_tick;
+    _last_tick = now;
+    _current   = to;
+    return from;
+}
+
+#ifndef C64_NO_PERF
+static void close_counters()
+{
+    int i;
+
+    for (i = 0; i < perf_num_counters; i++) {
+        if (_counter_fds[i] != -1) {
+            close(_counter_fds[i]);
+            _counter_fds[i] = -1;
+        }
+    }
+}
+
+/* Counts user space of the calling thread only, which runs the
+ * machine. Threads it starts, like the trace writer, are not counted. */
+static bool open_counters()
+{
+    struct perf_event_attr attr;
+    int                    leader = -1;
+    int                    i;
+
+    for (i = 0; i < perf_num_counters; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = _counter_events[i].type;
+        attr.config         = _counter_events[i].config;
+        attr.read_format    = PERF_FORMAT_GROUP;
+        attr.disabled       = leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        _counter_fds[i] = syscall(__NR_perf_event_open, &attr,
+                                  0, -1, leader, 0);
+        if (_counter_fds[i] == -1) {
+            close_counters();
+            return false;
+        }
+        if (leader == -1) {
+            leader = _counter_fds[i];
+        }
+    }
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+#endif
+
+static bool read_counters(uint64_t values[perf_num_counters])
+{
+    struct counter_group group;
+
+    if (_counter_fds[0] == -1 ||
+        read(_counter_fds[0], &group, sizeof(group)) != sizeof(group)) {
+        return false;
+    }
+    memcpy(values, group.values, sizeof(group.values));
+    return true;
+}
+
+static void add_frame(struct perf_frame *sum, const struct perf_frame *frame)
+{
+    int i;
+
+    for (i = 0; i < perf_num_subsystems; i++) {
+        sum->ns[i] += frame->ns[i];
+    }
+    for (i = 0; i < perf_num_counters; i++) {
+        sum->counters[i] += frame->counters[i];
+    }
+}
+
+static void write_dump(const struct perf_frame *sum, uint32_t frames)
+{
+    int i;
+
+    fprintf(_dump, "{\"frame\":%llu,\"frames\":%u",
+            (unsigned long long)_frames, frames);
+    for (i = 0; i < perf_num_subsystems; i++) {
+        fprintf(_dump, ",\"%s_ns\":%llu", _subsystem_names[i],
+                (unsigned long long)sum->ns[i]);
+    }
+    if (perf_has_counters()) {
+        for (i = 0; i < perf_num_counters; i++) {
+            fprintf(_dump, ",\"%s\":%llu", _counter_names[i],
+                    (unsigned long long)sum->counters[i]);
+        }
+    }
+    fprintf(_dump, "}\n");
+    fflush(_dump);
+}
+
+void perf_init()
+{
+    int i;
+
+    perf_enabled = false;
+    for (i = 0; i < perf_num_counters; i++) {
+        _counter_fds[i] = -1;
+    }
+    _dump = NULL;
+    perf_reset();
+}
+
+void perf_reset()
+{
+    memset(_ticks, 0, sizeof(_ticks));
+    memset(&_last, 0, sizeof(_last));
+    memset(&_total, 0, sizeof(_total));
+    memset(&_dump_sum, 0, sizeof(_dump_sum));
+    _frames           = 0;
+    _dump_frames      = 0;
+    _current          = perf_other;
+    _last_tick        = now_tick();
+    _calibration_tick = _last_tick;
+    _calibration_ns   = now_ns();
+    if (!read_counters(_counters_at_frame)) {
+        memset(_counters_at_frame, 0, sizeof(_counters_at_frame));
+    }
+}
+
+bool perf_enable(bool enable)
+{
+#ifdef C64_NO_PERF
+    return !enable;
+#else
+    if (enable && !perf_enabled) {
+        open_counters();
+        perf_reset();
+    }
+    if (!enable && perf_enabled) {
+        close_counters();
+    }
+    perf_enabled = enable;
+    return true;
+#endif
+}
+
+bool perf_is_enabled()
+{
+#ifdef C64_NO_PERF
+    return false;
+#else
+    return perf_enabled;
+#endif
+}
+
+bool perf_has_counters()
+{
+    return _counter_fds[0] != -1;
+}
+
+void perf_frame()
+{
+    struct perf_frame frame = { 0 };
+    uint64_t          counters[perf_num_counters];
+    uint64_t          ticks;
+    int64_t           ns;
+    int               i;
+
+    if (!perf_is_enabled()) {
+        return;
+    }
+    perf_account(_current);
+
+    ticks = _last_tick - _calibration_tick;
+    ns    = now_ns() - _calibration_ns;
+    for (i = 0; i < perf_num_subsystems; i++) {
+        frame.ns[i] = ticks ? (uint64_t)((double)_ticks[i] * ns / ticks) : 0;
+        _ticks[i]   = 0;
+    }
+    if (read_counters(counters)) {
+        for (i = 0; i < perf_num_counters; i++) {
+            frame.counters[i]     = counters[i] - _counters_at_frame[i];
+            _counters_at_frame[i] = counters[i];
+        }
+    }
+
+    _last = frame;
+    add_frame(&_total, &frame);
+    _frames++;
+
+    if (_dump) {
+        add_frame(&_dump_sum, &frame);
+        if (++_dump_frames >= _dump_period) {
+            write_dump(&_dump_sum, _dump_frames);
+            memset(&_dump_sum, 0, sizeof(_dump_sum));
+            _dump_frames = 0;
+        }
+    }
+}
+
+void perf_get_last(struct perf_frame *frame)
+{
+    *frame = _last;
+}
+
+void perf_get_total(struct perf_frame *frame, uint64_t *frames)
+{
+    *frame  = _total;
+    *frames = _frames;
+}
+
+bool perf_set_dump(const char *path, uint32_t period)
+{
+    if (_dump) {
+        fclose(_dump);
+        _dump = NULL;
+    }
+    if (!path) {
+        return true;
+    }
+    _dump = fopen(path, "w");
+    if (!_dump) {
+        return false;
+    }
+    _dump_period = period ? period : 1;
+    _dump_frames = 0;
+    memset(&_dump_sum, 0, sizeof(_dump_sum));
+    return true;
+}
+
+const char *perf_subsystem_name(enum perf_subsystem subsystem)
+{
+    return _subsystem_names[subsystem];
+}
+
+void perf_stat()
+{
+    uint64_t sum = 0;
+    int      i;
+
+    printf("Accounting     : %s%s\n", perf_is_enabled() ? "on" : "off",
+           perf_has_counters() ? ", hardware counters" : "");
+    printf("Frames         : %llu\n", (unsigned long long)_frames);
+    if (!_frames) {
+        return;
+    }
+    for (i = 0; i < perf_num_subsystems; i++) {
+        sum += _total.ns[i];
+    }
+    printf("%-14s   last frame us   avg frame us   share\n", "");
+    for (i = 0; i < perf_num_subsystems; i++) {
+        printf("%-14s : %13.1f   %12.1f   %4.1f%%\n",
+               _subsystem_names[i], _last.ns[i] / 1e3,
+               _total.ns[i] / 1e3 / _frames,
+               sum ? 100.0 * _total.ns[i] / sum : 0);
+    }
+    if (perf_has_counters()) {
+        for (i = 0; i < perf_num_counters; i++) {
+            printf("%-14s : %13llu   %12llu\n", _counter_names[i],
+                   (unsigned long long)_last.counters[i],
+                   (unsigned long long)(_total.counters[i] / _frames));
+        }
+    }
+}
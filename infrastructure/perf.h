@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Attributes host time to the subsystem running at the moment, per
+ * frame and in total. Host time is read from the time stamp counter
+ * where there is one. Hardware counters for instructions, cache
+ * misses and branch misses are read from perf events, where the
+ * kernel allows it, at every frame and thus only per frame.
+ *
+ * Accounting is off until enabled and compiled out with
+ * C64_NO_PERF. Switching subsystem costs a couple of time stamp
+ * reads when enabled and a single flag check otherwise. */
+
+enum perf_subsystem {
+    perf_other,
+    perf_cpu,
+    /* Memory hooks called by the CPU, ROM, I/O and color RAM */
+    perf_mem_hooks,
+    perf_vic,
+    perf_cia,
+    /* Refresh hook, presenting a frame and whatever else the front
+     * end does at the end of a frame */
+    perf_frontend,
+    perf_throttle,
+    perf_num_subsystems
+};
+
+enum perf_counter {
+    perf_instructions,
+    perf_cache_misses,
+    perf_branch_misses,
+    perf_num_counters
+};
+
+struct perf_frame {
+    uint64_t ns[perf_num_subsystems];
+    /* Only valid when perf_has_counters() */
+    uint64_t counters[perf_num_counters];
+};
+
+extern bool perf_enabled;
+enum perf_subsystem perf_account(enum perf_subsystem to);
+
+/* Time from now on is accounted to subsystem to, returns the
+ * subsystem to switch back to afterwards. */
+static inline enum perf_subsystem perf_switch(enum perf_subsystem to)
+{
+#ifndef C64_NO_PERF
+    if (__builtin_expect(perf_enabled, 0)) {
+        return perf_account(to);
+    }
+#endif
+    return to;
+}
+
+void perf_init();
+/* Clears all accounted time and counters */
+void perf_reset();
+
+/* False when compiled out */
+bool perf_enable(bool enable);
+bool perf_is_enabled();
+/* True when hardware counters could be opened */
+bool perf_has_counters();
+
+/* Call when a frame is complete */
+void perf_frame();
+
+/* Last complete frame and sum of all frames since reset */
+void perf_get_last(struct perf_frame *frame);
+void perf_get_total(struct perf_frame *frame, uint64_t *frames);
+
+/* Writes a JSON line with the sum of every period frames to path,
+ * NULL to stop. */
+bool perf_set_dump(const char *path, uint32_t period);
+
+const char *perf_subsystem_name(enum perf_subsystem subsystem);
+void perf_stat();
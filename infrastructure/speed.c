@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "speed.h"
+#include "perf.h"
+
+/* Length of measurement window */
+#define WINDOW_NS       1000000000LL
+/* Minimum time between presented frames in warp mode */
+#define PRESENT_NS        20000000LL
+/* Give up catching up when lagging more than this */
+#define MAX_LAG_NS       100000000LL
+
+static uint32_t _clock_hz;
+static bool     _warp;
+static bool     _started;
+
+/* Throttling */
+static int64_t  _deadline;
+static uint64_t _throttle_cycles;
+static int64_t  _last_present;
+
+struct window {
+    int64_t  start;
+    uint64_t cycles;
+    uint32_t frames;
+    int64_t  frame_min;
+    int64_t  frame_max;
+    int64_t  frame_sum;
+};
+
+/* Current measurement window and everything since reset */
+static struct window _window;
+static struct window _total;
+static int64_t       _frame_start;
+static int64_t       _total_end;
+static uint64_t      _total_cycles;
+
+/* Result of last complete window */
+static struct speed_stats _stats;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void start_window(struct window *w,
+                         int64_t now, uint64_t cycles)
+{
+    w->start     = now;
+    w->cycles    = cycles;
+    w->frames    = 0;
+    w->frame_min = INT64_MAX;
+    w->frame_max = 0;
+    w->frame_sum = 0;
+}
+
+static void add_frame(struct window *w, int64_t time)
+{
+    w->frames++;
+    w->frame_sum += time;
+    if (time < w->frame_min) {
+        w->frame_min = time;
+    }
+    if (time > w->frame_max) {
+        w->frame_max = time;
+    }
+}
+
+static void calculate(struct window *w, int64_t now, uint64_t cycles,
+                      struct speed_stats *stats)
+{
+    double seconds = (now - w->start) / 1e9;
+
+    if (w->frames == 0 || seconds <= 0) {
+        return;
+    }
+
+    stats->mhz          = (cycles - w->cycles) / seconds / 1e6;
+    stats->fps          = w->frames / seconds;
+    stats->percent      = stats->mhz * 1e6 * 100.0 / _clock_hz;
+    stats->frame_min_ms = w->frame_min / 1e6;
+    stats->frame_max_ms = w->frame_max / 1e6;
+    stats->frame_avg_ms = w->frame_sum / 1e6 / w->frames;
+}
+
+void speed_init(uint32_t clock_hz)
+{
+    _clock_hz = clock_hz;
+    _warp     = false;
+    speed_reset();
+}
+
+void speed_reset()
+{
+    int64_t now = now_ns();
+
+    memset(&_stats, 0, sizeof(_stats));
+    start_window(&_window, now, 0);
+    start_window(&_total, now, 0);
+    _started      = false;
+    _frame_start  = now;
+    _deadline     = now;
+    _last_present = 0;
+}
+
+void speed_frame(uint64_t cycles)
+{
+    int64_t now  = now_ns();
+    int64_t time = now - _frame_start;
+
+    /* First frame after reset only marks the starting point */
+    if (!_started) {
+        _started         = true;
+        _throttle_cycles = cycles;
+        _deadline        = now;
+        _frame_start     = now;
+        start_window(&_window, now, cycles);
+        start_window(&_total, now, cycles);
+        return;
+    }
+
+    add_frame(&_window, time);
+    add_frame(&_total, time);
+    _total_end    = now;
+    _total_cycles = cycles;
+
+    if (now - _window.start >= WINDOW_NS) {
+        calculate(&_window, now, cycles, &_stats);
+        start_window(&_window, now, cycles);
+    }
+
+    /* Emulated time that real time needs to catch up with */
+    _deadline += (int64_t)((cycles - _throttle_cycles) *
+                           1000000000LL / _clock_hz);
+    _throttle_cycles = cycles;
+    _frame_start     = now;
+}
+
+void speed_throttle()
+{
+    struct timespec     ts;
+    int64_t             now  = now_ns();
+    enum perf_subsystem from = perf_switch(perf_throttle);
+
+    if (_warp || now - _deadline > MAX_LAG_NS) {
+        /* Nothing to wait for, or too far behind to ever
+         * catch up, start over from now. */
+        _deadline = now;
+    }
+    else if (_deadline > now) {
+        ts.tv_sec  = _deadline / 1000000000LL;
+        ts.tv_nsec = _deadline % 1000000000LL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    /* Sleeping is not part of the frame time */
+    _frame_start = now_ns();
+    perf_switch(from);
+}
+
+bool speed_should_present()
+{
+    int64_t now;
+
+    if (!_warp) {
+        return true;
+    }
+    now = now_ns();
+    if (now - _last_present < PRESENT_NS) {
+        return false;
+    }
+    _last_present = now;
+    return true;
+}
+
+void speed_set_warp(bool warp)
+{
+    _warp = warp;
+}
+
+bool speed_is_warp()
+{
+    return _warp;
+}
+
+void speed_get(struct speed_stats *stats)
+{
+    *stats = _stats;
+}
+
+void speed_get_total(struct speed_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    calculate(&_total, _total_end, _total_cycles, stats);
+}
+
+void speed_describe(char *text, size_t size)
+{
+    snprintf(text, size,
+             "%.3f MHz %.1f fps %.0f%% frame %.2f/%.2f/%.2f ms%s",
+             _stats.mhz, _stats.fps, _stats.percent,
+             _stats.frame_min_ms, _stats.frame_avg_ms,
+             _stats.frame_max_ms, _warp ? " WARP" : "");
+}
+
+void speed_stat()
+{
+    printf("Warp           : %s\n", _warp ? "on" : "off");
+    printf("Emulated clock : %.3f MHz\n", _stats.mhz);
+    printf("Frames/second  : %.1f\n", _stats.fps);
+    printf("Real time      : %.0f%%\n", _stats.percent);
+    printf("Frame time min : %.3f ms\n", _stats.frame_min_ms);
+    printf("Frame time avg : %.3f ms\n", _stats.frame_avg_ms);
+    printf("Frame time max : %.3f ms\n", _stats.frame_max_ms);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Measures emulation speed against real time and throttles
+ * emulation to real time unless warp is turned on. */
+
+struct speed_stats {
+    double mhz;     /* Emulated clock */
+    double fps;     /* Emulated frames per host second */
+    double percent; /* Of real time */
+
+    /* Host time spent producing a frame, throttling excluded */
+    double frame_min_ms;
+    double frame_avg_ms;
+    double frame_max_ms;
+};
+
+void speed_init(uint32_t clock_hz);
+void speed_reset();
+
+/* Call when a frame has been produced, cycles is the total
+ * number of emulated cycles so far. */
+void speed_frame(uint64_t cycles);
+
+/* Sleeps until the emulated time has caught up with real time.
+ * Returns immediately in warp mode. */
+void speed_throttle();
+
+/* In warp mode frames are produced way faster than they can be
+ * shown, true when it is time to present one. */
+bool speed_should_present();
+
+void speed_set_warp(bool warp);
+bool speed_is_warp();
+
+/* Statistics from the last complete measurement window */
+void speed_get(struct speed_stats *stats);
+/* Statistics since reset */
+void speed_get_total(struct speed_stats *stats);
+void speed_describe(char *text, size_t size);
+void speed_stat();
@@ -1,18 +1,71 @@
 #include <string.h>
 #include <malloc.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "trace.h"
 
+/* Records in the ring, a power of 2 */
+#define RING_RECORDS  (1 << 16)
+/* Writer thread sleeps when there is nothing to write */
+#define WRITER_IDLE_NS 1000000
+/* Longest line written as text */
+#define TEXT_MAX      256
+
+_Static_assert(sizeof(struct trace_record) == 64,
+               "Trace records are expected to be 64 bytes");
+_Static_assert(sizeof(struct trace_execution) <= TRACE_PAYLOAD_SIZE,
+               "Execution trace does not fit payload");
+
+/* Single producer, the emulation, and single consumer, the writer
+ * thread. Each side only writes its own index. */
+struct trace_ring {
+    struct trace_record *records;
+    _Atomic uint64_t    head;
+    _Atomic uint64_t    tail;
+    atomic_bool         stop;
+    int                 fd;
+    pthread_t           writer;
+    bool                write_failed;
+    /* Times the emulation waited for the writer */
+    uint64_t            waits;
+};
+
 struct trace_point_item {
     struct trace_point      point;
     struct trace_point_item *next;
 };
 
 struct trace_point_item *_first;
+static uint16_t         _next_id;
+
+bool trace_any_enabled;
+
+static struct trace_ring _ring;
+static bool              _binary_open;
+static trace_context     _context;
+
+static void update_any_enabled()
+{
+    struct trace_point_item *item = _first;
+
+    trace_any_enabled = false;
+    while (item) {
+        if (item->point.fd != -1) {
+            trace_any_enabled = true;
+        }
+        item = item->next;
+    }
+}
 
 void trace_init()
 {
     _first = NULL;
+    trace_any_enabled = false;
 }
 
 struct trace_point* trace_add_point(const char *sys,
@@ -23,6 +76,7 @@ struct trace_point* trace_add_point(const char *sys,
     to_add->point.sys  = sys;
     to_add->point.name = name;
     to_add->point.fd   = -1;
+    to_add->point.id   = _next_id++;
     to_add->next       = NULL;
 
     if (_first == NULL) {
@@ -44,7 +98,7 @@ bool trace_enable_point(const char *sys,
     while (item) {
         if (strcmp(item->point.sys, sys) == 0 &&
             strcmp(item->point.name, name) == 0) {
-            item->point.fd = fd;
+            trace_set_fd(&item->point, fd);
             return true;
         }
         item = item->next;
@@ -52,6 +106,12 @@ bool trace_enable_point(const char *sys,
     return false;
 }
 
+void trace_set_fd(struct trace_point *point, int fd)
+{
+    point->fd = fd;
+    update_any_enabled();
+}
+
 struct trace_point* trace_enum_points(struct trace_point *curr)
 {
     struct trace_point_item *item;
@@ -74,3 +134,223 @@ int trace_count_points()
     }
     return count;
 }
+
+void trace_text(struct trace_point *point, const char *format, ...)
+{
+    struct trace_record *record;
+    char                text[TEXT_MAX];
+    va_list             args;
+    int                 len;
+
+    va_start(args, format);
+    if (point->fd == TRACE_FD_BINARY) {
+        record = trace_record_begin(point, trace_record_text);
+        if (record) {
+            len = vsnprintf((char*)record->payload, TRACE_PAYLOAD_SIZE,
+                            format, args);
+            record->size = len < TRACE_PAYLOAD_SIZE ?
+                           len : TRACE_PAYLOAD_SIZE - 1;
+            trace_record_commit();
+        }
+        va_end(args);
+        return;
+    }
+
+    /* Room for the newline is always left */
+    len = snprintf(text, sizeof(text) - 1, "%s %s: ",
+                   point->sys, point->name);
+    if (len < (int)sizeof(text) - 1) {
+        len += vsnprintf(text + len, sizeof(text) - 1 - len,
+                         format, args);
+    }
+    if (len > (int)sizeof(text) - 2) {
+        len = sizeof(text) - 2;
+    }
+    text[len++] = '\n';
+    write(point->fd, text, len);
+    va_end(args);
+}
+
+void trace_set_context(trace_context context)
+{
+    _context = context;
+}
+
+static void write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    ssize_t       written;
+
+    while (size > 0 && !_ring.write_failed) {
+        written = write(fd, bytes, size);
+        if (written <= 0) {
+            _ring.write_failed = true;
+            return;
+        }
+        bytes += written;
+        size  -= written;
+    }
+}
+
+/* Drains the ring to the file until stopped and empty */
+static void *writer_main(void *arg)
+{
+    struct timespec idle = { 0, WRITER_IDLE_NS };
+    uint64_t        head;
+    uint64_t        tail;
+    uint64_t        num;
+    bool            stop;
+
+    (void)arg;
+    for (;;) {
+        stop = atomic_load_explicit(&_ring.stop, memory_order_acquire);
+        head = atomic_load_explicit(&_ring.head, memory_order_acquire);
+        tail = atomic_load_explicit(&_ring.tail, memory_order_relaxed);
+        if (head == tail) {
+            if (stop) {
+                break;
+            }
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        /* Up to where the ring wraps */
+        num = head - tail;
+        if ((tail & (RING_RECORDS - 1)) + num > RING_RECORDS) {
+            num = RING_RECORDS - (tail & (RING_RECORDS - 1));
+        }
+        write_all(_ring.fd, &_ring.records[tail & (RING_RECORDS - 1)],
+                  num * sizeof(struct trace_record));
+        atomic_store_explicit(&_ring.tail, tail + num,
+                              memory_order_release);
+    }
+    return NULL;
+}
+
+bool trace_binary_open(const char *path)
+{
+    struct trace_file_header header = {
+        .magic       = TRACE_FILE_MAGIC,
+        .version     = TRACE_FILE_VERSION,
+        .record_size = sizeof(struct trace_record),
+    };
+    struct trace_point_item  *item;
+    struct trace_record      *record;
+    size_t                   len;
+
+    if (_binary_open) {
+        trace_binary_close();
+    }
+    memset(&_ring, 0, sizeof(_ring));
+    _ring.records = malloc(RING_RECORDS * sizeof(struct trace_record));
+    if (!_ring.records) {
+        return false;
+    }
+    _ring.fd = open(path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+    if (_ring.fd == -1) {
+        free(_ring.records);
+        return false;
+    }
+    write_all(_ring.fd, &header, sizeof(header));
+    if (pthread_create(&_ring.writer, NULL, writer_main, NULL) != 0) {
+        close(_ring.fd);
+        free(_ring.records);
+        return false;
+    }
+    _binary_open = true;
+
+    /* Names of all points, whichever will be recorded */
+    for (item = _first; item; item = item->next) {
+        record = trace_record_begin(&item->point, trace_record_point);
+        len    = strlen(item->point.sys) + 1;
+        snprintf((char*)record->payload, TRACE_PAYLOAD_SIZE, "%s",
+                 item->point.sys);
+        if (len < TRACE_PAYLOAD_SIZE) {
+            snprintf((char*)record->payload + len,
+                     TRACE_PAYLOAD_SIZE - len, "%s", item->point.name);
+        }
+        record->size = TRACE_PAYLOAD_SIZE;
+        trace_record_commit();
+    }
+    return true;
+}
+
+void trace_binary_close()
+{
+    struct trace_point_item *item;
+
+    if (!_binary_open) {
+        return;
+    }
+    for (item = _first; item; item = item->next) {
+        if (item->point.fd == TRACE_FD_BINARY) {
+            item->point.fd = -1;
+        }
+    }
+    update_any_enabled();
+
+    atomic_store_explicit(&_ring.stop, true, memory_order_release);
+    pthread_join(_ring.writer, NULL);
+    close(_ring.fd);
+    free(_ring.records);
+    _binary_open = false;
+}
+
+bool trace_binary_is_open()
+{
+    return _binary_open;
+}
+
+struct trace_record *trace_record_begin(struct trace_point *point,
+                                        enum trace_record_kind kind)
+{
+    struct trace_record *record;
+    uint64_t            head;
+
+    if (!_binary_open) {
+        return NULL;
+    }
+    head = atomic_load_explicit(&_ring.head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&_ring.tail, memory_order_acquire) ==
+        RING_RECORDS) {
+        _ring.waits++;
+        while (head - atomic_load_explicit(&_ring.tail,
+                                           memory_order_acquire) ==
+               RING_RECORDS) {
+            sched_yield();
+        }
+    }
+    record = &_ring.records[head & (RING_RECORDS - 1)];
+    memset(record, 0, sizeof(*record));
+    record->point = point->id;
+    record->kind  = kind;
+    if (_context) {
+        _context(record);
+    }
+    return record;
+}
+
+void trace_record_commit()
+{
+    uint64_t head = atomic_load_explicit(&_ring.head,
+                                         memory_order_relaxed);
+
+    atomic_store_explicit(&_ring.head, head + 1, memory_order_release);
+}
+
+void trace_binary_stat()
+{
+    uint64_t head;
+    uint64_t tail;
+
+    if (!_binary_open) {
+        printf("Binary trace   : closed\n");
+        return;
+    }
+    head = atomic_load(&_ring.head);
+    tail = atomic_load(&_ring.tail);
+    printf("Binary trace   : open%s\n",
+           _ring.write_failed ? ", write failed" : "");
+    printf("Records        : %llu\n", (unsigned long long)head);
+    printf("Not written yet: %llu\n", (unsigned long long)(head - tail));
+    printf("Waits on writer: %llu\n", (unsigned long long)_ring.waits);
+}
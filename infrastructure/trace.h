@@ -4,50 +4,45 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 
+/* Trace points are compiled out with C64_NO_TRACE. Otherwise every
+ * trace site first checks a single flag that is false unless some
+ * trace point is enabled. */
+#ifdef C64_NO_TRACE
+#define TRACE_ON(point) false
+#else
+extern bool trace_any_enabled;
+#define TRACE_ON(point)                                 \
+    (__builtin_expect(trace_any_enabled, 0) &&          \
+     point && point->fd != -1)
+#endif
+
 #define TRACE(point, format, args...)           \
-    if (point && point->fd != -1) {             \
-        char trace_buf[50];                     \
-        int  len;                               \
-        len = sprintf(trace_buf,                \
-                      "%s %s: ",                \
-                      point->sys, point->name); \
-        write(point->fd, trace_buf, len);       \
-        len = sprintf(trace_buf, format, args); \
-        write(point->fd, trace_buf, len);       \
-        write(point->fd, "\n", 1);              \
+    if (TRACE_ON(point)) {                      \
+        trace_text(point, format, args);        \
     }
 
 #define TRACE0(point, text)                     \
-    if (point && point->fd != -1) {             \
-        char trace_buf[50];                     \
-        int  len;                               \
-        len = sprintf(trace_buf,                \
-                      "%s %s: ",                \
-                      point->sys, point->name); \
-        write(point->fd, trace_buf, len);       \
-        write(point->fd, text, strlen(text));   \
-        write(point->fd, "\n", 1);              \
+    if (TRACE_ON(point)) {                      \
+        trace_text(point, "%s", text);          \
     }
 
-#define TRACE_NOT_IMPL(point, feature)              \
-    if (point && point->fd != -1) {                 \
-        char trace_buf[50];                         \
-        int  len;                                   \
-        len = sprintf(trace_buf,                    \
-                      "%s %s: ",                    \
-                      point->sys, point->name);     \
-        write(point->fd, trace_buf, len);           \
-        write(point->fd, feature, strlen(feature)); \
-        write(point->fd, "\n", 1);                  \
+#define TRACE_NOT_IMPL(point, feature)          \
+    if (TRACE_ON(point)) {                      \
+        trace_text(point, "%s", feature);       \
     }
 
+/* Points with this fd are recorded to the binary trace */
+#define TRACE_FD_BINARY -2
 
 struct trace_point {
     const char *sys;
     const char *name;
     int        fd;
+    /* Identifies point in binary traces */
+    uint16_t   id;
 };
 void trace_init(); 
 struct trace_point* trace_add_point(const char *sys,
@@ -55,8 +50,84 @@ struct trace_point* trace_add_point(const char *sys,
 bool trace_enable_point(const char *sys,
                         const char *name,
                         int fd);
+/* Enables point writing to fd, or disables it with -1 */
+void trace_set_fd(struct trace_point *point, int fd);
 
 struct trace_point* trace_enum_points(struct trace_point *curr);
 int trace_count_points();
 
+/* Writes "<sys> <name>: <text>" to the fd of point, or records the
+ * text when the point records to the binary trace. */
+void trace_text(struct trace_point *point, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Binary trace
+ *
+ * Events are recorded as fixed size records in a ring buffer that a
+ * thread drains to a file, the emulation only waits when the ring is
+ * full. The file starts with a trace_file_header followed by
+ * records, see tools/trace_decode.c for turning it into text. */
+
+#define TRACE_FILE_MAGIC   "C64T"
+#define TRACE_FILE_VERSION 1
+#define TRACE_PAYLOAD_SIZE 45
+
+enum trace_record_kind {
+    /* Payload is "<sys>\0<name>" of point id, recorded when the
+     * point starts recording */
+    trace_record_point,
+    /* Payload is the text */
+    trace_record_text,
+    /* Payload is struct trace_execution */
+    trace_record_execution,
+};
+
+struct trace_record {
+    uint64_t cycle;
+    uint16_t point;
+    uint8_t  kind;
+    uint8_t  size;
+    /* CPU when recorded, before the instruction for execution */
+    uint16_t pc;
+    uint8_t  reg_a;
+    uint8_t  reg_x;
+    uint8_t  reg_y;
+    uint8_t  flags;
+    uint8_t  sp;
+    uint8_t  payload[TRACE_PAYLOAD_SIZE];
+};
+
+/* Instruction executed and registers after */
+struct trace_execution {
+    uint8_t bytes[3];
+    uint8_t reg_a;
+    uint8_t reg_x;
+    uint8_t reg_y;
+    uint8_t flags;
+    uint8_t sp;
+};
+
+struct trace_file_header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+/* Fills in cycle and CPU state of a record */
+typedef void (*trace_context)(struct trace_record *record);
+void trace_set_context(trace_context context);
+
+/* Starts a thread writing recorded events to path */
+bool trace_binary_open(const char *path);
+/* Writes what is left and stops the thread, points recording to the
+ * binary trace are turned off. */
+void trace_binary_close();
+bool trace_binary_is_open();
+
+/* Next record in the ring with point, kind and context filled in,
+ * NULL when the binary trace is not open. Commit when filled in. */
+struct trace_record *trace_record_begin(struct trace_point *point,
+                                        enum trace_record_kind kind);
+void trace_record_commit();
 
+void trace_binary_stat();
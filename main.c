@@ -1,7 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "emulation/c64.h"
+#include "emulation/boot.h"
+#include "emulation/trap.h"
+#include "emulation/rewind.h"
+#include "emulation/input.h"
 
 #include "infrastructure/commandline.h"
+#include "infrastructure/speed.h"
+#include "infrastructure/perf.h"
 
 #include "ui/ncurses_c64.h"
 #include "ui/sdl_c64.h"
@@ -9,9 +18,69 @@
 
 int main(int argc, char **argv)
 {
-    bool exit = false;
+    bool       exit       = false;
+    const char *rom_dir    = NULL;
+    const char *boot_cache = NULL;
+    const char *drive_dir  = NULL;
+    const char *record     = NULL;
+    const char *replay     = NULL;
+    int        run_ahead  = 0;
+    int        opt;
 
-    if (c64_init("..") != 0) {
+    while ((opt = getopt(argc, argv, "r:B:d:a:i:I:")) != -1) {
+        switch (opt) {
+        case 'r':
+            rom_dir = optarg;
+            break;
+        case 'B':
+            boot_cache = optarg;
+            break;
+        case 'd':
+            drive_dir = optarg;
+            break;
+        case 'a':
+            run_ahead = strtol(optarg, NULL, 10);
+            break;
+        case 'i':
+            record = optarg;
+            break;
+        case 'I':
+            replay = optarg;
+            break;
+        default:
+            printf("Usage: %s [-r <rom directory>] "
+                   "[-B <boot cache file>] "
+                   "[-d <device 8 directory>] "
+                   "[-a <frames to run ahead>] "
+                   "[-i <input log to record>] "
+                   "[-I <input log to replay>]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    if (c64_init(rom_dir) != 0) {
+        return -1;
+    }
+    if (drive_dir) {
+        trap_set_directory(drive_dir);
+    }
+    /* A replayed log starts where it was recorded */
+    if (boot_cache && !replay && boot_to_ready(boot_cache) != 0) {
+        return -1;
+    }
+    if (record && !input_record(record)) {
+        printf("Failed to record input to %s\n", record);
+        return -1;
+    }
+    if (replay && !input_replay(replay)) {
+        printf("Failed to replay input from %s\n", replay);
+        return -1;
+    }
+
+    speed_init(C64_CLOCK_HZ);
+    perf_init();
+    rewind_enable(true);
+    if (run_ahead && !c64_set_run_ahead(run_ahead)) {
         return -1;
     }
 
@@ -24,6 +93,8 @@ int main(int argc, char **argv)
         sdl_c64_loop();
         commandline_loop();
     }
+    /* Ends the log */
+    input_stop();
 
     return 0;
 }
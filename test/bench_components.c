@@ -0,0 +1,413 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "c64.h"
+#include "boot.h"
+#include "cia1.h"
+
+/* Microbenchmarks of the machine's components, each from the state
+ * at READY. Prints a JSON line per benchmark:
+ *
+ *   {"name":"cpu_step/alu","ops":1000000,"repeats":5,
+ *    "ns_per_op":12.345,"min_ns_per_op":12.001,
+ *    "max_ns_per_op":13.002,"emulated_mhz":162.014}
+ *
+ * ns_per_op is the median of the repeats. emulated_mhz is the
+ * emulated time an op stands for per host time, null for operations
+ * that are not timed like memory accesses. Keys and their order only
+ * change with BENCH_FORMAT. Booting prints to stdout as well, -o
+ * writes a file with the results only. */
+
+#define BENCH_FORMAT 1
+
+#define PROGRAM     0x1000
+#define MAX_REPEATS 100
+
+struct bench {
+    const char *name;
+    /* Emulated cycles an op stands for, 0 when not timed */
+    int        cycles;
+    void       (*setup)();
+    void       (*run)(uint64_t ops);
+};
+
+static struct c64_saved_state _ready;
+static struct cpu_state       _cpu;
+static volatile uint8_t       _sink;
+
+/* Instruction mixes, each loops forever */
+static const uint8_t _alu[] = {
+    0x18,             /* CLC */
+    0xa9, 0x01,       /* LDA #$01 */
+    0x69, 0x02,       /* ADC #$02 */
+    0xaa,             /* TAX */
+    0xe8,             /* INX */
+    0x88,             /* DEY */
+    0x0a,             /* ASL A */
+    0x49, 0x55,       /* EOR #$55 */
+    0x29, 0x0f,       /* AND #$0F */
+    0x09, 0x30,       /* ORA #$30 */
+    0xc9, 0x20,       /* CMP #$20 */
+    0xa8,             /* TAY */
+    0x38,             /* SEC */
+    0xe9, 0x01,       /* SBC #$01 */
+    0x4c, 0x00, 0x10, /* JMP $1000 */
+};
+static const uint8_t _memory[] = {
+    0xad, 0x00, 0x20, /* LDA $2000 */
+    0x8d, 0x01, 0x20, /* STA $2001 */
+    0xa6, 0x80,       /* LDX $80 */
+    0x86, 0x81,       /* STX $81 */
+    0xee, 0x02, 0x20, /* INC $2002 */
+    0xbd, 0x00, 0x20, /* LDA $2000,X */
+    0x99, 0x00, 0x21, /* STA $2100,Y */
+    0xb1, 0xfb,       /* LDA ($FB),Y */
+    0x91, 0xfd,       /* STA ($FD),Y */
+    0x4c, 0x00, 0x10, /* JMP $1000 */
+};
+static const uint8_t _branch[] = {
+    0xa2, 0x08,       /* LDX #$08 */
+    0xca,             /* DEX */
+    0xd0, 0xfd,       /* BNE $1002 */
+    0x20, 0x0b, 0x10, /* JSR $100B */
+    0x4c, 0x00, 0x10, /* JMP $1000 */
+    0x60,             /* RTS */
+};
+
+static void load_program(const uint8_t *program, size_t size)
+{
+    memcpy(mem_get_ram(PROGRAM), program, size);
+    cpu_get_state(&_cpu);
+    _cpu.pc     = PROGRAM;
+    _cpu.flags |= FLAG_IRQ_DISABLE;
+    cpu_set_state(&_cpu);
+}
+
+static void setup_alu()
+{
+    load_program(_alu, sizeof(_alu));
+}
+
+static void setup_memory()
+{
+    load_program(_memory, sizeof(_memory));
+}
+
+static void setup_branch()
+{
+    load_program(_branch, sizeof(_branch));
+}
+
+static void run_cpu(uint64_t ops)
+{
+    while (ops--) {
+        cpu_step(&_cpu);
+    }
+}
+
+static void setup_nothing()
+{
+}
+
+/* Memory is accessed from base, mask picks the offset from the op */
+static uint16_t _base;
+static uint16_t _mask;
+
+static void setup_ram()
+{
+    _base = 0x1000;
+    _mask = 0xff;
+}
+
+static void setup_basic_rom()
+{
+    _base = 0xa000;
+    _mask = 0xff;
+}
+
+static void setup_kernal_rom()
+{
+    _base = 0xe000;
+    _mask = 0xff;
+}
+
+static void setup_vic_regs()
+{
+    /* Up to the collision registers, reading those clears them */
+    _base = 0xd000;
+    _mask = 0x0f;
+}
+
+static void setup_color_ram()
+{
+    _base = 0xd800;
+    _mask = 0xff;
+}
+
+static void setup_cia_regs()
+{
+    /* Timer A, reading has no side effects */
+    _base = 0xdc04;
+    _mask = 0x01;
+}
+
+static void run_get(uint64_t ops)
+{
+    uint8_t  sum = 0;
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        sum += mem_get_for_cpu(_base + (i & _mask));
+    }
+    _sink = sum;
+}
+
+static void run_set(uint64_t ops)
+{
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        mem_set_for_cpu(_base + (i & _mask), i);
+    }
+}
+
+static void setup_vic_border()
+{
+    /* Border and background colors */
+    _base = 0xd020;
+    _mask = 0x01;
+}
+
+static void setup_text_mode()
+{
+}
+
+static void setup_bitmap_mode()
+{
+    mem_set_for_cpu(0xd018, 0x18);
+    mem_set_for_cpu(0xd011, mem_get_for_cpu(0xd011) | 0x20);
+}
+
+static void setup_display_off()
+{
+    mem_set_for_cpu(0xd011, mem_get_for_cpu(0xd011) & ~0x10);
+}
+
+/* An op is a cycle, with the skipping the machine does */
+static void run_vic(uint64_t ops)
+{
+    int  skip  = 0;
+    bool stall = false;
+
+    while (ops--) {
+        if (skip) {
+            skip--;
+        }
+        else {
+            vic_step(&skip, &stall);
+        }
+    }
+}
+
+static void run_cia(uint64_t ops)
+{
+    while (ops--) {
+        cia1_cycle();
+    }
+}
+
+static void setup_keyboard()
+{
+    keyboard_down(KEYB_A);
+    /* Every line, like the KERNAL looking for any key */
+    keyboard_set_port_A(0x00, 0xff);
+}
+
+static void run_keyboard(uint64_t ops)
+{
+    uint8_t sum = 0;
+
+    while (ops--) {
+        sum += keyboard_get_port_B(0xff);
+    }
+    _sink = sum;
+}
+
+/* Switches BASIC in and out, hooks of the pages are installed again
+ * each time */
+static void run_pla(uint64_t ops)
+{
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        pla_pins_from_cpu(i & 1, true, true);
+    }
+}
+
+static const struct bench _benches[] = {
+    { "cpu_step/alu",         2, setup_alu,         run_cpu },
+    { "cpu_step/memory",      2, setup_memory,      run_cpu },
+    { "cpu_step/branch",      2, setup_branch,      run_cpu },
+    { "mem_get/ram",          0, setup_ram,         run_get },
+    { "mem_get/basic_rom",    0, setup_basic_rom,   run_get },
+    { "mem_get/kernal_rom",   0, setup_kernal_rom,  run_get },
+    { "mem_get/vic",          0, setup_vic_regs,    run_get },
+    { "mem_get/color_ram",    0, setup_color_ram,   run_get },
+    { "mem_get/cia",          0, setup_cia_regs,    run_get },
+    { "mem_set/ram",          0, setup_ram,         run_set },
+    { "mem_set/under_rom",    0, setup_basic_rom,   run_set },
+    { "mem_set/vic",          0, setup_vic_border,  run_set },
+    { "mem_set/color_ram",    0, setup_color_ram,   run_set },
+    { "vic_step/text",        1, setup_text_mode,   run_vic },
+    { "vic_step/bitmap",      1, setup_bitmap_mode, run_vic },
+    { "vic_step/display_off", 1, setup_display_off, run_vic },
+    { "cia1_cycle",           2, setup_nothing,     run_cia },
+    { "keyboard_get_port_B",  0, setup_keyboard,    run_keyboard },
+    { "pla_configure",        0, setup_nothing,     run_pla },
+};
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void measure(FILE *f, const struct bench *bench, uint64_t ops,
+                    uint64_t warmup, int repeats)
+{
+    double ns[MAX_REPEATS];
+    double start;
+    double median;
+    int    i;
+
+    c64_restore_state(&_ready);
+    keyboard_reset();
+    bench->setup();
+    bench->run(warmup);
+    for (i = 0; i < repeats; i++) {
+        start = now();
+        bench->run(ops);
+        ns[i] = (now() - start) / ops;
+    }
+    qsort(ns, repeats, sizeof(ns[0]), compare);
+    median = repeats % 2 ? ns[repeats / 2] :
+                           (ns[repeats / 2 - 1] + ns[repeats / 2]) / 2;
+
+    fprintf(f, "{\"name\":\"%s\",\"ops\":%llu,\"repeats\":%d,"
+            "\"ns_per_op\":%.3f,\"min_ns_per_op\":%.3f,"
+            "\"max_ns_per_op\":%.3f,\"emulated_mhz\":",
+            bench->name, (unsigned long long)ops, repeats, median,
+            ns[0], ns[repeats - 1]);
+    if (bench->cycles) {
+        fprintf(f, "%.3f}\n", bench->cycles / median * 1000);
+    }
+    else {
+        fprintf(f, "null}\n");
+    }
+    fflush(f);
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [options]\n"
+           "  -n <num>    Ops per repeat, default 1000000\n"
+           "  -w <num>    Ops to warm up with, default a tenth of -n\n"
+           "  -r <num>    Repeats, the median is reported, default 5\n"
+           "  -f <text>   Only benchmarks with text in their name\n"
+           "  -o <file>   Write results to file, default stdout\n"
+           "  -l          List benchmarks\n"
+           "Results are JSON lines, format %d.\n",
+           name, BENCH_FORMAT);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter  = NULL;
+    const char *output  = NULL;
+    uint64_t   ops      = 1000000;
+    uint64_t   warmup   = 0;
+    int        repeats  = 5;
+    bool       list     = false;
+    FILE       *f       = stdout;
+    size_t     i;
+    int        opt;
+
+    while ((opt = getopt(argc, argv, "n:w:r:f:o:lh")) != -1) {
+        switch (opt) {
+        case 'n':
+            ops = strtoull(optarg, NULL, 10);
+            break;
+        case 'w':
+            warmup = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            repeats = strtol(optarg, NULL, 10);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'l':
+            list = true;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (list) {
+        for (i = 0; i < sizeof(_benches) / sizeof(_benches[0]); i++) {
+            printf("%s\n", _benches[i].name);
+        }
+        return 0;
+    }
+    if (ops < 1 || repeats < 1 || repeats > MAX_REPEATS) {
+        usage(argv[0]);
+        return -1;
+    }
+    if (!warmup) {
+        warmup = ops / 10;
+    }
+
+    if (c64_init(NULL) != 0 || boot_to_ready(NULL) != 0) {
+        return -1;
+    }
+    /* What is measured is the component, not what skips it */
+    c64_set_idle_skip(false);
+    c64_set_loop_acceleration(false);
+    c64_save_state(&_ready);
+
+    if (output) {
+        f = fopen(output, "w");
+        if (!f) {
+            printf("Failed to open %s\n", output);
+            return -1;
+        }
+    }
+    for (i = 0; i < sizeof(_benches) / sizeof(_benches[0]); i++) {
+        if (!filter || strstr(_benches[i].name, filter)) {
+            measure(f, &_benches[i], ops, warmup, repeats);
+        }
+    }
+    if (output) {
+        fclose(f);
+    }
+    return 0;
+}
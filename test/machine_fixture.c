@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "c64.h"
+#include "boot.h"
+#include "machine_fixture.h"
+
+/* SEI, fills $2000-$20ff with the counter at $0400, CLI, counts */
+static const uint8_t _fill[] = {
+    0x78, 0xa2, 0x00, 0xad, 0x00, 0x04, 0x9d, 0x00,
+    0x20, 0xe8, 0xd0, 0xfa, 0x58, 0xee, 0x00, 0x04,
+    0x4c, 0x00, 0xc0,
+};
+
+static struct c64_saved_state _ready;
+static bool                   _booted;
+
+bool fixture_boot()
+{
+    if (_booted) {
+        return true;
+    }
+    if (c64_init(NULL) != 0 || boot_to_ready(NULL) != 0) {
+        printf("Failed to boot\n");
+        return false;
+    }
+    c64_save_state(&_ready);
+    _booted = true;
+    return true;
+}
+
+void fixture_ready()
+{
+    c64_restore_state(&_ready);
+}
+
+void fixture_start_program()
+{
+    c64_restore_state(&_ready);
+    memcpy(mem_get_ram(FIXTURE_PROGRAM), _fill, sizeof(_fill));
+    memcpy(mem_get_ram(0x0277), "SYS49152\r", 9);
+    *mem_get_ram(0x00c6) = 9;
+}
+
+void fixture_run(uint64_t frames)
+{
+    uint64_t end = c64_frames() + frames;
+
+    while (c64_frames() < end) {
+        c64_step();
+    }
+}
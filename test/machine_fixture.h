@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Whole machine at BASIC READY, shared by the suites running it.
+ * The program put in place fills $2000-$20ff with the counter at
+ * $0400 with interrupts disabled, then counts it up. */
+
+#define FIXTURE_PROGRAM 0xc000
+
+/* Powers on and boots to READY, once for all tests of a suite */
+bool fixture_boot();
+
+/* Back at READY as booted */
+void fixture_ready();
+
+/* At READY with the program started from the keyboard buffer, it
+ * runs once BASIC reads the buffer */
+void fixture_start_program();
+
+void fixture_run(uint64_t frames);
@@ -2304,3 +2304,42 @@ int test_increment_register()
     };
     return run_tests(tests, sizeof(tests) / sizeof(tests[0]));
 }
+
+static int _stores;
+
+static void counting_store(uint16_t addr, uint8_t val)
+{
+    _stores++;
+    mem_set(addr, val);
+}
+
+/* Executed instructions are counted, stores can be redirected */
+int test_instruction_count_and_store()
+{
+    /* INX, STA $2000, NOP, STA $2001 */
+    const char       code[] = { 0xe8, 0x8d, 0x00, 0x20, 0xea,
+                                0x8d, 0x01, 0x20 };
+    struct cpu_state state  = { .pc = CODE, .sp = 0xff, .reg_a = 0x42 };
+    int              i;
+
+    memcpy(_ram + CODE, code, sizeof(code));
+    cpu_set_state(&state);
+    _stores = 0;
+    cpu_set_store(counting_store);
+    for (i = 0; i < 3; i++) {
+        cpu_step(&state);
+    }
+    cpu_set_store(NULL);
+    cpu_step(&state);
+
+    if (state.instructions != 4) {
+        printf("Expected 4 instructions but was %llu\n",
+               (unsigned long long)state.instructions);
+        return 0;
+    }
+    if (_stores != 1 || _ram[0x2000] != 0x42 || _ram[0x2001] != 0x42) {
+        printf("Expected one redirected store of two, was %d\n", _stores);
+        return 0;
+    }
+    return 1;
+}
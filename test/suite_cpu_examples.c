@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "cpu_calls.h"
 
 #define RAM_SIZE 65536
 #define CODE 0x1000
@@ -236,3 +237,455 @@ int test_half_integer_of_four_bytes()
     }
     return 1;
 }
+
+/* VIC registers from 0xd000 are polled, the rest of I/O volatile */
+static enum cpu_mem_kind classify(uint16_t addr, bool write)
+{
+    if (addr < 0xd000) {
+        return cpu_mem_stable;
+    }
+    if (addr < 0xd400 && !write) {
+        return cpu_mem_polled;
+    }
+    return cpu_mem_volatile;
+}
+
+static uint16_t _polled[CPU_IDLE_LOOP_MAX_POLLED];
+static int      _num_polled;
+
+/* Steps program until an idle loop is reported, returns its length */
+static int find_idle_loop(const uint8_t *program, int size)
+{
+    int length = 0;
+
+    memcpy(_ram + CODE, program, size);
+    _state.pc = CODE;
+    _state.sp = 0xff;
+    _state.flags = 0x00;
+    _num_polled = 0;
+    cpu_set_state(&_state);
+    cpu_set_idle_detection(classify);
+    for (int s = 0; s < 100 && !length; s++) {
+        cpu_step(NULL);
+        length = cpu_idle_loop(_polled, &_num_polled);
+    }
+    cpu_set_idle_detection(NULL);
+    return length;
+}
+
+int test_idle_loop_polling_memory()
+{
+    /* KERNAL waiting for keyboard buffer */
+    const uint8_t program[] = {
+        /* LDA $c6   */ 0xa5, 0xc6,
+        /* STA $cc   */ 0x85, 0xcc,
+        /* STA $0292 */ 0x8d, 0x92, 0x02,
+        /* BEQ -9    */ 0xf0, 0xf7,
+    };
+    struct cpu_state state;
+    int              length = find_idle_loop(program, sizeof(program));
+
+    cpu_get_state(&state);
+    if (length != 4 || state.pc != CODE || _num_polled != 0) {
+        printf("Idle loop of %d instructions at %04x\n", length, state.pc);
+        return 0;
+    }
+    return 1;
+}
+
+int test_idle_loop_jump_to_self()
+{
+    const uint8_t program[] = {
+        /* JMP $1000 */ 0x4c, 0x00, 0x10,
+    };
+
+    return find_idle_loop(program, sizeof(program)) == 1;
+}
+
+int test_no_idle_loop_when_writing()
+{
+    /* Counts, memory changes every iteration */
+    const uint8_t program[] = {
+        /* INC $5000 */ 0xee, 0x00, 0x50,
+        /* JMP $1000 */ 0x4c, 0x00, 0x10,
+    };
+
+    return find_idle_loop(program, sizeof(program)) == 0;
+}
+
+int test_idle_loop_polling_raster()
+{
+    /* Waits for raster line */
+    const uint8_t program[] = {
+        /* LDA $d012 */ 0xad, 0x12, 0xd0,
+        /* CMP #$80  */ 0xc9, 0x80,
+        /* BNE -7    */ 0xd0, 0xf9,
+    };
+    int length;
+
+    _ram[0xd012] = 0x10;
+    length = find_idle_loop(program, sizeof(program));
+    if (length != 3 || _num_polled != 1 || _polled[0] != 0xd012) {
+        printf("Idle loop of %d instructions polling %d\n",
+               length, _num_polled);
+        return 0;
+    }
+    return 1;
+}
+
+int test_no_idle_loop_when_polling_io()
+{
+    /* Waits for key, reading CIA ports is not side effect free */
+    const uint8_t program[] = {
+        /* LDA $dc01 */ 0xad, 0x01, 0xdc,
+        /* CMP #$ff  */ 0xc9, 0xff,
+        /* BEQ -7    */ 0xf0, 0xf9,
+    };
+
+    _ram[0xdc01] = 0xff;
+    return find_idle_loop(program, sizeof(program)) == 0;
+}
+
+int test_idle_loop_resume_on_raster()
+{
+    /* Waits for raster line $80 */
+    const uint8_t program[] = {
+        /* LDA $d012 */ 0xad, 0x12, 0xd0,
+        /* CMP #$80  */ 0xc9, 0x80,
+        /* BNE -7    */ 0xd0, 0xf9,
+    };
+    struct cpu_state state;
+
+    _ram[0xd012] = 0x10;
+    if (find_idle_loop(program, sizeof(program)) != 3) {
+        return 0;
+    }
+    cpu_set_idle_detection(classify);
+
+    /* Another line, still waiting */
+    _ram[0xd012] = 0x7f;
+    cpu_run_idle(5);
+    if (cpu_idle_resume(_polled, &_num_polled) != 3) {
+        return 0;
+    }
+    /* The line, the loop ends */
+    _ram[0xd012] = 0x80;
+    cpu_run_idle(2);
+    cpu_get_state(&state);
+    if (state.pc != CODE + 3 || state.reg_a != 0x7f) {
+        printf("At %04x with A %02x\n", state.pc, state.reg_a);
+        return 0;
+    }
+    return cpu_idle_resume(_polled, &_num_polled) == 0;
+}
+
+/* Plain RAM except for I/O */
+static uint8_t *loop_page(uint8_t page, bool write)
+{
+    if (page >= 0xd0 && page < 0xe0) {
+        return NULL;
+    }
+    return (uint8_t *)_ram + (page << 8);
+}
+
+/* Runs program until BRK, returns instructions and steps taken */
+static void run_loop(const uint8_t *program, int size, uint8_t flags,
+                     int *instructions, int *steps)
+{
+    memcpy(_ram + CODE, program, size);
+    _ram[CODE + size] = 0x00;
+    memset(&_state, 0, sizeof(_state));
+    _state.pc    = CODE;
+    _state.sp    = 0xff;
+    _state.flags = flags;
+    cpu_set_state(&_state);
+    *instructions = 0;
+    *steps        = 0;
+    while (_ram[_state.pc] != 0x00 && *steps < 100000) {
+        *instructions += cpu_step(&_state);
+        (*steps)++;
+    }
+}
+
+/* Anything but zero page, set up by the test */
+static void fill_ram()
+{
+    for (int i = 0x100; i < RAM_SIZE; i++) {
+        _ram[i] = i * 13 + (i >> 8);
+    }
+}
+
+/* Same outcome with and without acceleration, true if accelerated */
+static bool compare_loop(const uint8_t *program, int size,
+                         uint8_t flags, bool *accelerated)
+{
+    static char      ram[RAM_SIZE];
+    char             zero_page[0x100];
+    struct cpu_state state;
+    int              instructions;
+    int              steps;
+    int              expected;
+
+    fill_ram();
+    memcpy(zero_page, _ram, sizeof(zero_page));
+    cpu_set_loop_acceleration(NULL);
+    run_loop(program, size, flags, &expected, &steps);
+    memcpy(ram, _ram, RAM_SIZE);
+    memcpy(_ram, zero_page, sizeof(zero_page));
+    state = _state;
+
+    fill_ram();
+    cpu_set_loop_acceleration(loop_page);
+    run_loop(program, size, flags, &instructions, &steps);
+    cpu_set_loop_acceleration(NULL);
+
+    *accelerated = steps < instructions;
+    if (instructions != expected ||
+        state.reg_a != _state.reg_a || state.reg_x != _state.reg_x ||
+        state.reg_y != _state.reg_y || state.flags != _state.flags) {
+        printf("Executed %d/%d A %02x/%02x X %02x/%02x "
+               "Y %02x/%02x P %02x/%02x\n", instructions, expected,
+               _state.reg_a, state.reg_a, _state.reg_x, state.reg_x,
+               _state.reg_y, state.reg_y, _state.flags, state.flags);
+        return false;
+    }
+    return memcmp(ram, _ram, RAM_SIZE) == 0;
+}
+
+int test_loop_fill()
+{
+    /* Clears the screen */
+    const uint8_t program[] = {
+        /* LDA #$20    */ 0xa9, 0x20,
+        /* LDX #$00    */ 0xa2, 0x00,
+        /* STA $0400,X */ 0x9d, 0x00, 0x04,
+        /* STA $0500,X */ 0x9d, 0x00, 0x05,
+        /* STA $0600,X */ 0x9d, 0x00, 0x06,
+        /* STA $06e8,X */ 0x9d, 0xe8, 0x06,
+        /* DEX         */ 0xca,
+        /* BNE -15     */ 0xd0, 0xf1,
+    };
+    bool accelerated;
+
+    return compare_loop(program, sizeof(program), FLAG_IRQ_DISABLE,
+                        &accelerated) && accelerated;
+}
+
+int test_loop_copy_indirect()
+{
+    const uint8_t program[] = {
+        /* LDY #$10      */ 0xa0, 0x10,
+        /* LDA ($fb),Y   */ 0xb1, 0xfb,
+        /* STA ($fd),Y   */ 0x91, 0xfd,
+        /* INY           */ 0xc8,
+        /* BNE -7        */ 0xd0, 0xf9,
+    };
+    bool accelerated;
+
+    _ram[0xfb] = 0x80;
+    _ram[0xfc] = 0x20;
+    _ram[0xfd] = 0x00;
+    _ram[0xfe] = 0x30;
+    return compare_loop(program, sizeof(program), FLAG_IRQ_DISABLE,
+                        &accelerated) && accelerated;
+}
+
+int test_loop_copy_overlapping()
+{
+    /* Smears the first byte over the page */
+    const uint8_t program[] = {
+        /* LDY #$00    */ 0xa0, 0x00,
+        /* LDA $3000,Y */ 0xb9, 0x00, 0x30,
+        /* STA $3001,Y */ 0x99, 0x01, 0x30,
+        /* INY         */ 0xc8,
+        /* BNE -9      */ 0xd0, 0xf7,
+    };
+    bool accelerated;
+
+    return compare_loop(program, sizeof(program), FLAG_IRQ_DISABLE,
+                        &accelerated) && accelerated;
+}
+
+int test_loop_not_accelerated()
+{
+    /* Interrupts enabled, storing to I/O or to a pointer */
+    const uint8_t copy[] = {
+        /* LDX #$00    */ 0xa2, 0x00,
+        /* LDA $0400,X */ 0xbd, 0x00, 0x04,
+        /* STA $0800,X */ 0x9d, 0x00, 0x08,
+        /* DEX         */ 0xca,
+        /* BNE -9      */ 0xd0, 0xf7,
+    };
+    const uint8_t color[] = {
+        /* LDX #$00    */ 0xa2, 0x00,
+        /* STA $d800,X */ 0x9d, 0x00, 0xd8,
+        /* DEX         */ 0xca,
+        /* BNE -6      */ 0xd0, 0xfa,
+    };
+    const uint8_t pointer[] = {
+        /* LDA #$20    */ 0xa9, 0x20,
+        /* LDY #$00    */ 0xa0, 0x00,
+        /* STA ($fb),Y */ 0x91, 0xfb,
+        /* INY         */ 0xc8,
+        /* BNE -5      */ 0xd0, 0xfb,
+    };
+    bool accelerated;
+
+    if (!compare_loop(copy, sizeof(copy), 0x00, &accelerated) ||
+        accelerated) {
+        return 0;
+    }
+    if (!compare_loop(color, sizeof(color), FLAG_IRQ_DISABLE,
+                      &accelerated) || accelerated) {
+        return 0;
+    }
+    /* Overwrites its pointer half way, the iterations after that are
+     * accelerated. */
+    _ram[0xfb] = 0x00;
+    _ram[0xfc] = 0x00;
+    return compare_loop(pointer, sizeof(pointer), FLAG_IRQ_DISABLE,
+                        &accelerated);
+}
+
+int test_profile()
+{
+    const uint8_t program[] = {
+        /* LDA #$20    */ 0xa9, 0x20,
+        /* LDX #$00    */ 0xa2, 0x00,
+        /* STA $0400,X */ 0x9d, 0x00, 0x04,
+        /* DEX         */ 0xca,
+        /* BNE -6      */ 0xd0, 0xfa,
+    };
+    const struct cpu_profile_entry *profile;
+    uint64_t                       counted = 0;
+    int                            instructions;
+    int                            steps;
+    bool                           ok;
+    int                            i;
+
+    cpu_set_profile(true);
+    profile = cpu_profile();
+    run_loop(program, sizeof(program), 0x00, &instructions, &steps);
+    ok = profile[CODE].instructions == 1 && profile[CODE].cycles == 2 &&
+         profile[CODE + 4].instructions == 256 &&
+         profile[CODE + 4].cycles == 256 * 5;
+
+    /* Accelerated iterations are counted at the start of the loop */
+    cpu_profile_reset();
+    cpu_set_loop_acceleration(loop_page);
+    run_loop(program, sizeof(program), FLAG_IRQ_DISABLE,
+             &instructions, &steps);
+    cpu_set_loop_acceleration(NULL);
+    for (i = 0; i < RAM_SIZE; i++) {
+        counted += profile[i].instructions;
+    }
+    ok = ok && steps < instructions && counted == (uint64_t)instructions;
+
+    cpu_set_profile(false);
+    return ok && cpu_profile() == NULL;
+}
+
+static bool expect_routine(const struct cpu_calls_routine *routines,
+                           int num, uint16_t address, uint64_t inclusive,
+                           uint64_t exclusive)
+{
+    for (int i = 0; i < num; i++) {
+        if (routines[i].address == address) {
+            if (routines[i].calls != 1 ||
+                routines[i].inclusive != inclusive ||
+                routines[i].exclusive != exclusive) {
+                printf("%04x calls %llu cycles %llu/%llu\n", address,
+                       (unsigned long long)routines[i].calls,
+                       (unsigned long long)routines[i].inclusive,
+                       (unsigned long long)routines[i].exclusive);
+                return false;
+            }
+            return true;
+        }
+    }
+    printf("%04x not called\n", address);
+    return false;
+}
+
+int test_call_graph()
+{
+    const uint8_t program[] = {
+        /* JSR $1010 */ 0x20, 0x10, 0x10,
+        /* JSR $1020 */ 0x20, 0x20, 0x10,
+        /* JSR $1060 */ 0x20, 0x60, 0x10,
+    };
+    const uint8_t calls[] = {
+        /* $1010 JSR $1030 */ 0x20, 0x30, 0x10,
+        /* $1013 RTS       */ 0x60,
+    };
+    const uint8_t nop[] = {
+        /* $1030 NOP       */ 0xea,
+        /* $1031 RTS       */ 0x60,
+    };
+    const uint8_t drops[] = {
+        /* $1020 JSR $1040 */ 0x20, 0x40, 0x10,
+        /* $1023 RTS       */ 0x60,
+    };
+    const uint8_t drop_return[] = {
+        /* $1040 PLA       */ 0x68,
+        /* $1041 PLA       */ 0x68,
+        /* $1042 RTS       */ 0x60,
+    };
+    const uint8_t jump[] = {
+        /* $1060 LDA #$10  */ 0xa9, 0x10,
+        /* $1062 PHA       */ 0x48,
+        /* $1063 LDA #$4f  */ 0xa9, 0x4f,
+        /* $1065 PHA       */ 0x48,
+        /* $1066 RTS       */ 0x60,
+    };
+    const char expected[] =
+        "root 18\n"
+        "root;1010 12\n"
+        "root;1010;1030 8\n"
+        "root;1020 12\n"
+        "root;1020;1040 8\n"
+        "root;1060 22\n";
+    struct cpu_calls_routine routines[8];
+    char                     folded[256] = { 0 };
+    int                      instructions;
+    int                      steps;
+    int                      num;
+    int                      fds[2];
+
+    memcpy(_ram + 0x1010, calls, sizeof(calls));
+    memcpy(_ram + 0x1030, nop, sizeof(nop));
+    memcpy(_ram + 0x1020, drops, sizeof(drops));
+    memcpy(_ram + 0x1040, drop_return, sizeof(drop_return));
+    memcpy(_ram + 0x1060, jump, sizeof(jump));
+    /* Jumped to by RTS */
+    _ram[0x1050] = 0x60;
+
+    cpu_set_call_graph(true);
+    run_loop(program, sizeof(program), 0x00, &instructions, &steps);
+    cpu_set_call_graph(false);
+
+    /* Leaving the routine that dropped its return address also leaves
+     * its caller, an RTS jumping within a routine does not leave it. */
+    num = cpu_calls_routines(routines, 8);
+    if (num != 5 ||
+        !expect_routine(routines, num, 0x1010, 20, 12) ||
+        !expect_routine(routines, num, 0x1030, 8, 8) ||
+        !expect_routine(routines, num, 0x1020, 20, 12) ||
+        !expect_routine(routines, num, 0x1040, 8, 8) ||
+        !expect_routine(routines, num, 0x1060, 22, 22)) {
+        return 0;
+    }
+
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+    cpu_calls_write_folded(fds[1]);
+    close(fds[1]);
+    read(fds[0], folded, sizeof(folded) - 1);
+    close(fds[0]);
+    if (strcmp(folded, expected) != 0) {
+        printf("%s", folded);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "c64.h"
+#include "boot.h"
+#include "explore.h"
+
+/* Runs copies of the machine at READY, each typing another key. */
+
+#define NUM_COPIES 4
+#define RUN_CYCLES 200000
+
+static const uint16_t _keys[NUM_COPIES] = {
+    KEYB_A, KEYB_B, KEYB_C, KEYB_D,
+};
+
+static struct c64_saved_state _ready;
+
+int once_before()
+{
+    if (c64_init(NULL) != 0 || boot_to_ready(NULL) != 0) {
+        printf("Failed to boot\n");
+        return -1;
+    }
+    c64_save_state(&_ready);
+    return 0;
+}
+
+int each_before()
+{
+    c64_restore_state(&_ready);
+    return 0;
+}
+
+/* Screen code at the start of the line with the cursor */
+static double type_key(int copy, void *ctx)
+{
+    struct explore_input inputs[] = {
+        { .cycle = 0,     .key = _keys[copy], .down = true },
+        { .cycle = 40000, .key = _keys[copy], .down = false },
+    };
+    uint16_t line;
+
+    explore_run(inputs, 2, RUN_CYCLES);
+    line = *mem_get_ram(0x00d1) | *mem_get_ram(0x00d2) << 8;
+    return *mem_get_ram(line);
+}
+
+int test_copies_run_their_own_input()
+{
+    struct explore_result results[NUM_COPIES];
+    uint8_t               ram[0x10000];
+    struct cpu_state      before;
+    struct cpu_state      after;
+    uint64_t              cycles = c64_cycles();
+    int                   i;
+
+    memcpy(ram, mem_get_ram(0), sizeof(ram));
+    cpu_get_state(&before);
+    if (!explore(NUM_COPIES, 2, type_key, NULL, results)) {
+        printf("Failed to explore\n");
+        return 0;
+    }
+    for (i = 0; i < NUM_COPIES; i++) {
+        /* Screen codes of A to D are 1 to 4 */
+        if (!results[i].ok || results[i].fitness != i + 1 ||
+            results[i].cycles < cycles + RUN_CYCLES) {
+            printf("Copy %d: ok %d fitness %.0f cycles %llu\n",
+                   i, results[i].ok, results[i].fitness,
+                   (unsigned long long)results[i].cycles);
+            return 0;
+        }
+    }
+
+    cpu_get_state(&after);
+    if (c64_cycles() != cycles ||
+        memcmp(ram, mem_get_ram(0), sizeof(ram)) != 0 ||
+        memcmp(&before, &after, sizeof(before)) != 0) {
+        printf("Machine copied has changed\n");
+        return 0;
+    }
+    return 1;
+}
+
+static double nothing(int copy, void *ctx)
+{
+    return 0;
+}
+
+int test_other_children_are_left_alone()
+{
+    struct explore_result results[NUM_COPIES];
+    pid_t                 other = fork();
+    int                   status;
+
+    if (other == 0) {
+        _exit(7);
+    }
+    /* Has exited before any copy does */
+    usleep(10000);
+    if (!explore(NUM_COPIES, NUM_COPIES, nothing, NULL, results)) {
+        printf("Failed to explore\n");
+        return 0;
+    }
+    if (waitpid(other, &status, 0) != other || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 7) {
+        printf("Other child was reaped\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* The first copy runs until the last has started, which is only
+ * once a copy started after the first has ended */
+static double wait_for_last(int copy, void *ctx)
+{
+    volatile int *started = ctx;
+    int          i;
+
+    if (copy == NUM_COPIES - 1) {
+        *started = 1;
+    }
+    else if (copy == 0) {
+        for (i = 0; i < 500 && !*started; i++) {
+            usleep(10000);
+        }
+    }
+    return *started;
+}
+
+int test_workers_are_freed_by_any_copy()
+{
+    struct explore_result results[NUM_COPIES];
+    int                   *started;
+    bool                  ok;
+
+    started = mmap(NULL, sizeof(*started), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (started == MAP_FAILED) {
+        return 0;
+    }
+    *started = 0;
+    ok = explore(NUM_COPIES, NUM_COPIES - 1, wait_for_last, started,
+                 results);
+    munmap(started, sizeof(*started));
+    if (!ok) {
+        printf("Failed to explore\n");
+        return 0;
+    }
+    if (!results[0].ok || results[0].fitness != 1) {
+        printf("Last copy waited for the first to end\n");
+        return 0;
+    }
+    return 1;
+}
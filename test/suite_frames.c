@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c64.h"
+#include "boot.h"
+
+/* Runs scripted workloads from READY and hashes every frame drawn.
+ * The hashes are compared with those in the golden directory, one
+ * per line and frame. With C64_GOLDEN_UPDATE set in the environment
+ * the goldens are written instead, check what changed before
+ * committing them. */
+
+#ifndef C64_GOLDEN_PATH
+#define C64_GOLDEN_PATH "golden"
+#endif
+
+#define MAX_FRAMES 1024
+
+static struct c64_saved_state _ready;
+static uint64_t               _hashes[MAX_FRAMES];
+static int                    _num_hashes;
+
+static void on_refresh()
+{
+    if (_num_hashes < MAX_FRAMES) {
+        _hashes[_num_hashes++] = c64_framebuffer_hash();
+    }
+}
+
+static void run(uint64_t frames)
+{
+    uint64_t end = c64_frames() + frames;
+
+    while (c64_frames() < end) {
+        c64_step();
+    }
+}
+
+/* Types text as from the keyboard, a return ends a line */
+static void type(const char *text)
+{
+    uint8_t *pending = mem_get_ram(0x00c6);
+    size_t  len      = strlen(text);
+    size_t  num;
+
+    while (len) {
+        while (*pending) {
+            c64_step();
+        }
+        /* Keyboard buffer holds ten */
+        num = len < 10 ? len : 10;
+        memcpy(mem_get_ram(0x0277), text, num);
+        *pending = num;
+        text += num;
+        len  -= num;
+    }
+    while (*pending) {
+        c64_step();
+    }
+}
+
+static bool update()
+{
+    return getenv("C64_GOLDEN_UPDATE") != NULL;
+}
+
+/* Compares the hashes with the golden, or writes it */
+static bool check(const char *name)
+{
+    char               path[1024];
+    FILE               *f;
+    unsigned long long golden;
+    int                i;
+
+    snprintf(path, sizeof(path), "%s/%s.txt", C64_GOLDEN_PATH, name);
+    if (update()) {
+        f = fopen(path, "w");
+        if (!f) {
+            printf("Failed to write %s\n", path);
+            return false;
+        }
+        for (i = 0; i < _num_hashes; i++) {
+            fprintf(f, "%016llx\n", (unsigned long long)_hashes[i]);
+        }
+        fclose(f);
+        return true;
+    }
+
+    f = fopen(path, "r");
+    if (!f) {
+        printf("No golden %s\n", path);
+        return false;
+    }
+    for (i = 0; i < _num_hashes; i++) {
+        if (fscanf(f, "%llx", &golden) != 1) {
+            printf("%s: golden ends at frame %d of %d\n",
+                   name, i, _num_hashes);
+            fclose(f);
+            return false;
+        }
+        if (golden != _hashes[i]) {
+            printf("%s: frame %d is %016llx, golden %016llx\n",
+                   name, i, (unsigned long long)_hashes[i], golden);
+            fclose(f);
+            return false;
+        }
+    }
+    if (fscanf(f, "%llx", &golden) == 1) {
+        printf("%s: golden has more than %d frames\n", name, _num_hashes);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+int once_before()
+{
+    if (c64_init(NULL) != 0 || boot_to_ready(NULL) != 0) {
+        printf("Failed to boot\n");
+        return -1;
+    }
+    c64_save_state(&_ready);
+    return 0;
+}
+
+int each_before()
+{
+    c64_set_run_ahead(0);
+    c64_restore_state(&_ready);
+    c64_screen_default();
+    /* Not part of the state, the frame restored in is drawn from
+     * where the beam is and the lines of the vertical blank not at
+     * all */
+    memset(c64_framebuffer(), 0, C64_SCREEN_WIDTH * C64_SCREEN_HEIGHT *
+           sizeof(uint32_t));
+    c64_set_refresh_hook(on_refresh);
+    _num_hashes = 0;
+    return 0;
+}
+
+int test_basic_screen()
+{
+    type("POKE53280,0:POKE53281,6\r");
+    type("PRINT\"GOLDEN FRAMES\",6*7\r");
+    type("LIST\r");
+    run(50);
+    return check("basic_screen");
+}
+
+int test_text_scrolls_up()
+{
+    type("10 PRINT\"SCROLLING\";:GOTO10\r");
+    type("RUN\r");
+    run(100);
+    return check("text_scroll");
+}
+
+int test_fine_scroll()
+{
+    type("10 FORI=0TO7:POKE53270,200+I:POKE53265,24+I:NEXT:GOTO10\r");
+    type("RUN\r");
+    run(100);
+    return check("fine_scroll");
+}
+
+int test_bitmap_mode()
+{
+    type("POKE53272,24:POKE53265,59\r");
+    type("FORI=8192TO8791:POKEI,IAND255:NEXT\r");
+    run(100);
+    return check("bitmap_mode");
+}
+
+/* Hashes of the frames shown running the program typed, run ahead
+ * only after it is typed as it cannot know about keys to come */
+static void run_with(const char *program, int run_ahead, uint64_t *hashes,
+                     int *num)
+{
+    each_before();
+    type(program);
+    _num_hashes = 0;
+    c64_set_run_ahead(run_ahead);
+    run(100);
+    memcpy(hashes, _hashes, _num_hashes * sizeof(*hashes));
+    *num = _num_hashes;
+    c64_set_run_ahead(0);
+}
+
+int test_run_ahead_shows_frames_ahead()
+{
+    static uint64_t normal[MAX_FRAMES];
+    static uint64_t ahead[MAX_FRAMES];
+    const char      *program =
+        "10 FORI=0TO7:POKE53270,200+I:POKE53265,24+I:NEXT\r"
+        "20 PRINT\"RUN AHEAD\";:POKE53280,I:GOTO10\rRUN\r";
+    int             num_normal;
+    int             num_ahead;
+    int             frames;
+    int             i;
+
+    run_with(program, 0, normal, &num_normal);
+    for (frames = 1; frames <= 3; frames++) {
+        run_with(program, frames, ahead, &num_ahead);
+        if (num_ahead != num_normal) {
+            printf("%d frames shown with run ahead %d, %d without\n",
+                   num_ahead, frames, num_normal);
+            return 0;
+        }
+        /* Each is the frame shown that many frames later without */
+        for (i = 0; i + frames < num_normal; i++) {
+            if (ahead[i] != normal[i + frames]) {
+                printf("Run ahead %d: frame %d differs\n", frames, i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
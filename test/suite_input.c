@@ -0,0 +1,188 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c64.h"
+#include "input.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "trap.h"
+#include "machine_fixture.h"
+
+/* Records a session of input from READY, replays its log from READY
+ * and expects the same machine and screen bit for bit. The log and
+ * the program loaded are kept in the build directory. */
+
+#ifndef C64_LOG_PATH
+#define C64_LOG_PATH "suite_input.log"
+#endif
+#define PRG_PATH C64_LOG_PATH ".prg"
+
+/* Loaded to the top line of the screen, LOADED in screen codes */
+static const uint8_t _prg[] = {
+    0x00, 0x04, 0x0c, 0x0f, 0x01, 0x04, 0x05, 0x04,
+};
+
+static size_t   _size;
+static uint8_t  *_recorded;
+static uint8_t  *_replayed;
+static uint64_t _hash;
+
+static void clear_framebuffer()
+{
+    memset(c64_framebuffer(), 0, C64_SCREEN_WIDTH * C64_SCREEN_HEIGHT *
+           sizeof(uint32_t));
+}
+
+int once_before()
+{
+    FILE *f;
+
+    if (!fixture_boot()) {
+        return -1;
+    }
+    f = fopen(PRG_PATH, "wb");
+    if (!f || fwrite(_prg, sizeof(_prg), 1, f) != 1 || fclose(f) != 0) {
+        printf("Failed to write %s\n", PRG_PATH);
+        return -1;
+    }
+    _size     = savestate_size();
+    _recorded = malloc(_size);
+    _replayed = malloc(_size);
+    return _recorded && _replayed ? 0 : -1;
+}
+
+/* At READY with what the front ends start with */
+int each_before()
+{
+    input_stop();
+    rewind_enable(false);
+    c64_set_idle_skip(true);
+    c64_set_loop_acceleration(true);
+    trap_set_acceleration(true);
+    c64_set_run_ahead(0);
+    fixture_ready();
+    clear_framebuffer();
+    return 0;
+}
+
+static void press(uint16_t key)
+{
+    input_key_down(key);
+    fixture_run(3);
+    input_key_up(key);
+}
+
+/* Every kind of input there is from the front ends, what the machine
+ * is like at the end is kept */
+static bool record()
+{
+    uint16_t start;
+    uint16_t size;
+
+    rewind_set_period(1);
+    if (!rewind_enable(true) || !input_record(C64_LOG_PATH)) {
+        printf("Failed to record %s\n", C64_LOG_PATH);
+        return false;
+    }
+    fixture_run(10);
+    press(KEYB_A);
+    fixture_run(10);
+    /* Typed and then taken back, by going back to the snapshot before
+     * it went down */
+    input_key_down(KEYB_B);
+    fixture_run(1);
+    if (!input_rewind_back()) {
+        printf("Failed to rewind\n");
+        return false;
+    }
+    fixture_run(5);
+    input_color_ram_fill(0, 2, 500);
+    fixture_run(5);
+    if (input_load_prg(PRG_PATH, &start, &size) != 0) {
+        printf("Failed to load %s\n", PRG_PATH);
+        return false;
+    }
+    fixture_run(5);
+    press(KEYB_RETURN);
+    fixture_run(20);
+    input_stop();
+    rewind_enable(false);
+    rewind_set_period(REWIND_DEFAULT_PERIOD);
+
+    savestate_write(_recorded);
+    _hash = c64_framebuffer_hash();
+    return true;
+}
+
+/* From READY again, until the end of the log */
+static bool replay()
+{
+    fixture_ready();
+    clear_framebuffer();
+    if (!input_replay(C64_LOG_PATH)) {
+        printf("Failed to replay %s\n", C64_LOG_PATH);
+        return false;
+    }
+    while (input_is_replaying()) {
+        c64_step();
+    }
+    savestate_write(_replayed);
+    if (memcmp(_recorded, _replayed, _size) != 0) {
+        printf("Machine differs after replaying\n");
+        return false;
+    }
+    if (c64_framebuffer_hash() != _hash) {
+        printf("Screen differs after replaying\n");
+        return false;
+    }
+    return true;
+}
+
+int test_replay_reproduces_session()
+{
+    if (!record()) {
+        return 0;
+    }
+    if (*mem_get_ram(0x0400) != _prg[2]) {
+        printf("Program was not loaded\n");
+        return 0;
+    }
+    return replay();
+}
+
+int test_replay_uses_settings_of_log()
+{
+    c64_set_idle_skip(false);
+    c64_set_loop_acceleration(false);
+    trap_set_acceleration(false);
+    c64_set_run_ahead(2);
+    if (!record()) {
+        return 0;
+    }
+
+    /* The other way round, the log has them */
+    c64_set_idle_skip(true);
+    c64_set_loop_acceleration(true);
+    trap_set_acceleration(true);
+    c64_set_run_ahead(0);
+    fixture_ready();
+    if (!input_replay(C64_LOG_PATH)) {
+        printf("Failed to replay %s\n", C64_LOG_PATH);
+        return 0;
+    }
+    input_stop();
+    if (c64_is_idle_skip() || c64_is_loop_acceleration() ||
+        trap_is_acceleration() || c64_get_run_ahead() != 2) {
+        printf("Settings not taken from the log\n");
+        return 0;
+    }
+
+    c64_set_idle_skip(true);
+    c64_set_loop_acceleration(true);
+    trap_set_acceleration(true);
+    c64_set_run_ahead(0);
+    return replay();
+}
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "mem.h"
+#include "coverage.h"
 
 /* Recorded from last hook call */
 uint8_t _val;
@@ -174,3 +175,59 @@ int test_remove_get_hook_for_cpu()
     }
     return assert_val(val, 0x10);
 }
+
+int test_coverage()
+{
+    const struct coverage *coverage;
+    bool                   ok;
+
+    /* Nothing recorded until enabled */
+    mem_get_for_cpu(0x2000);
+    coverage_enable(true);
+    coverage_reset();
+    coverage = coverage_get();
+
+    mem_fetch_for_cpu(0x1000);
+    mem_fetch_for_cpu(0x1000);
+    mem_get_for_cpu(0x1001);
+    mem_set_for_cpu(0x10ff, 0x01);
+    coverage_enable(false);
+    mem_set_for_cpu(0x10ff, 0x01);
+
+    ok = coverage->counters[coverage_cpu_fetch][0x1000] == 2 &&
+         coverage->counters[coverage_cpu_read][0x1000] == 0 &&
+         coverage->counters[coverage_cpu_read][0x1001] == 1 &&
+         coverage->counters[coverage_cpu_read][0x2000] == 0 &&
+         coverage->counters[coverage_cpu_write][0x10ff] == 1 &&
+         coverage->bitmaps[coverage_cpu_fetch][0x1000 >> 3] == 0x01 &&
+         coverage->bitmaps[coverage_cpu_read][0x1000 >> 3] == 0x02 &&
+         coverage->bitmaps[coverage_cpu_write][0x10ff >> 3] == 0x80 &&
+         coverage->pages[0x10][coverage_cpu_fetch] == 2 &&
+         coverage->pages[0x10][coverage_cpu_read] == 1 &&
+         coverage->pages[0x10][coverage_cpu_write] == 1;
+    return ok;
+}
+
+int test_dirty_pages()
+{
+    const bool *dirty = mem_dirty_pages();
+    int        page;
+
+    mem_clear_dirty();
+    mem_set_for_cpu(0x2080, 0x01);
+    mem_get_page_for_cpu(0x30, true);
+    mem_get_page_for_cpu(0x40, false);
+    mem_set_dirty(0x50ff, 2);
+
+    for (page = 0; page < 256; page++) {
+        bool expected = page == 0x20 || page == 0x30 ||
+                        page == 0x50 || page == 0x51;
+
+        if (dirty[page] != expected) {
+            printf("Page %02x should%s be dirty\n", page,
+                   expected ? "" : " not");
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -5,6 +5,7 @@
 #include "emulation/basic.h"
 #include "emulation/kernal.h"
 #include "emulation/pla.h"
+#include "infrastructure/metrics.h"
 
 
 static uint8_t _basic_rom[8192];
@@ -175,3 +176,31 @@ int test_map_after_reset()
 }
 
 
+
+int test_metrics()
+{
+    metrics_reset();
+    mem_get_for_cpu(kernal_address());
+    mem_get_for_cpu(basic_address());
+    mem_set_for_cpu(0xd020, 0x01);
+    mem_get_for_cpu(0xdc0d);
+    mem_get_for_cpu(0x1000);
+    pla_pins_from_cpu(true, true, true);
+
+    if (metrics.hook_calls[metrics_hooks_rom] != 2) {
+        printf("Expected 2 ROM hook calls, got %llu\n",
+               (unsigned long long)metrics.hook_calls[metrics_hooks_rom]);
+        return 0;
+    }
+    if (metrics.hook_calls[metrics_hooks_vic] != 1 ||
+        metrics.hook_calls[metrics_hooks_cia1] != 1 ||
+        metrics.hook_calls[metrics_hooks_sid] != 0) {
+        printf("Hook calls not counted per chip\n");
+        return 0;
+    }
+    if (metrics.pla_configs != 1) {
+        printf("Expected 1 PLA configuration\n");
+        return 0;
+    }
+    return 1;
+}
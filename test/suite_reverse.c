@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c64.h"
+#include "input.h"
+#include "rewind.h"
+#include "reverse.h"
+#include "savestate.h"
+#include "machine_fixture.h"
+
+/* Records frames with rewind on and a key pressed, keeps the state
+ * at some instruction counts, and executes backwards to them. */
+
+#ifndef C64_READY_PATH
+#define C64_READY_PATH "suite_reverse.state"
+#endif
+
+#define PROGRAM  0xc000
+#define CLRLN    0xe9ff
+#define INC_ADDR 0xc005
+#define KEPT     3
+
+/* LDX #$05, JSR CLRLN which is trapped, INC $0400, JMP $C000 */
+static const uint8_t _program[] = {
+    0xa2, 0x05, 0x20, 0xff, 0xe9, 0xee, 0x00, 0x04,
+    0x4c, 0x00, 0xc0,
+};
+
+static size_t   _size;
+static uint8_t  *_now;
+/* Plain step, start of a trapped routine, after a key went down in
+ * the frame */
+static uint8_t  *_states[KEPT];
+static uint64_t _instructions[KEPT];
+/* Where the trapped routine ends and when the key went down */
+static uint64_t _trap_end;
+static uint64_t _key_down;
+
+static uint64_t instructions()
+{
+    struct cpu_state state;
+
+    cpu_get_state(&state);
+    return state.instructions;
+}
+
+static uint16_t pc()
+{
+    struct cpu_state state;
+
+    cpu_get_state(&state);
+    return state.pc;
+}
+
+int once_before()
+{
+    int i;
+
+    if (!fixture_boot()) {
+        return -1;
+    }
+    fixture_ready();
+    if (!savestate_save(C64_READY_PATH)) {
+        printf("Failed to save %s\n", C64_READY_PATH);
+        return -1;
+    }
+    _size = savestate_size();
+    _now  = malloc(_size);
+    for (i = 0; i < KEPT; i++) {
+        _states[i] = malloc(_size);
+        if (!_states[i]) {
+            return -1;
+        }
+    }
+    return _now ? 0 : -1;
+}
+
+/* At READY running the program, input kept from tests before is
+ * forgotten as the state is replaced */
+int each_before()
+{
+    struct cpu_state state;
+
+    rewind_enable(false);
+    if (!input_restore_state(C64_READY_PATH)) {
+        printf("Failed to restore %s\n", C64_READY_PATH);
+        return -1;
+    }
+    memcpy(mem_get_ram(PROGRAM), _program, sizeof(_program));
+    cpu_get_state(&state);
+    state.pc = PROGRAM;
+    cpu_set_state(&state);
+    c64_set_idle_skip(false);
+    c64_set_loop_acceleration(false);
+    rewind_set_period(1);
+    rewind_set_budget(REWIND_DEFAULT_BUDGET);
+    return 0;
+}
+
+static void steps(int num)
+{
+    while (num--) {
+        c64_step();
+    }
+}
+
+static void keep(int index)
+{
+    _instructions[index] = instructions();
+    savestate_write(_states[index]);
+}
+
+/* 20 frames, the key is down from the start of frame 12 to the
+ * middle of frame 14. No snapshot is taken between the key going
+ * down and the state kept after it. */
+static bool record()
+{
+    uint64_t frame;
+
+    if (!rewind_enable(true)) {
+        printf("Out of memory\n");
+        return false;
+    }
+    fixture_run(4);
+    steps(200);
+    keep(0);
+
+    fixture_run(4);
+    while (pc() != CLRLN) {
+        c64_step();
+    }
+    keep(1);
+    c64_step();
+    _trap_end = instructions();
+    if (_trap_end <= _instructions[1] + 1) {
+        printf("CLRLN was not trapped\n");
+        return false;
+    }
+
+    fixture_run(4);
+    frame = c64_frames();
+    steps(10);
+    input_key_down(KEYB_A);
+    _key_down = instructions();
+    /* Until the interrupt puts it in the keyboard buffer */
+    while (!*mem_get_ram(0x00c6)) {
+        c64_step();
+    }
+    steps(10);
+    keep(2);
+    if (c64_frames() != frame) {
+        printf("Key and state kept not in one frame\n");
+        return false;
+    }
+
+    fixture_run(2);
+    steps(300);
+    input_key_up(KEYB_A);
+    fixture_run(6);
+    return true;
+}
+
+static bool is_state(int index)
+{
+    savestate_write(_now);
+    if (instructions() != _instructions[index] ||
+        memcmp(_now, _states[index], _size) != 0) {
+        printf("Not the state kept %d, %llu instructions\n", index,
+               (unsigned long long)instructions());
+        return false;
+    }
+    return true;
+}
+
+static bool back_to(uint64_t count, int index)
+{
+    if (!reverse_step(instructions() - count)) {
+        printf("Failed to step back to %llu\n", (unsigned long long)count);
+        return false;
+    }
+    return is_state(index);
+}
+
+int test_step_back_to_kept_states()
+{
+    uint64_t cycles;
+
+    if (!record()) {
+        return 0;
+    }
+    /* The key down is applied again on the way */
+    if (!back_to(_instructions[2], 2)) {
+        return 0;
+    }
+    /* Stops before the trapped routine, not in it */
+    if (!back_to(_instructions[1] + (_trap_end - _instructions[1]) / 2,
+                 1)) {
+        return 0;
+    }
+    if (!back_to(_instructions[0], 0)) {
+        return 0;
+    }
+    /* Before the first snapshot, nothing changes */
+    cycles = c64_cycles();
+    if (reverse_step(instructions()) || c64_cycles() != cycles ||
+        !is_state(0)) {
+        printf("Stepped back past the history\n");
+        return 0;
+    }
+    return 1;
+}
+
+int test_back_to_last_write()
+{
+    uint8_t  *buffer = mem_get_ram(0x0277);
+    uint8_t  *screen = mem_get_ram(0x0400);
+    uint8_t  counter;
+    uint64_t inc;
+    uint64_t now;
+
+    if (!record()) {
+        return 0;
+    }
+    counter = *screen;
+    /* Past the INC and into the next round, an interrupt may be taken
+     * where it is about to be executed */
+    do {
+        inc = instructions();
+        c64_step();
+    } while (*screen == counter);
+    while (pc() != CLRLN) {
+        c64_step();
+    }
+    if (!reverse_to_write(0x0400) || pc() != INC_ADDR ||
+        instructions() != inc) {
+        printf("Not before the INC, at %04x after %llu\n", pc(),
+               (unsigned long long)instructions());
+        return 0;
+    }
+
+    /* The key went into the keyboard buffer frames and snapshots ago,
+     * the scan goes back through them */
+    now = instructions();
+    if (!reverse_to_write(0x0277) || instructions() >= now ||
+        instructions() < _key_down || *buffer == 'A') {
+        printf("Not before the key was put in the buffer\n");
+        return 0;
+    }
+    c64_step();
+    if (*buffer != 'A') {
+        printf("Next step did not write the key\n");
+        return 0;
+    }
+
+    /* Never written, the machine is where it was */
+    now = instructions();
+    if (reverse_to_write(PROGRAM + sizeof(_program)) ||
+        instructions() != now) {
+        printf("Found a write never made\n");
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,163 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c64.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "machine_fixture.h"
+
+/* Records the whole machine with a snapshot every frame, steps back
+ * and expects exactly the state that was there at that frame. */
+
+#define FRAMES 100
+
+static size_t   _size;
+/* Serialized state and instructions executed after each frame */
+static uint8_t  *_states[FRAMES + 1];
+static uint64_t _instructions[FRAMES + 1];
+static uint8_t  *_now;
+
+int once_before()
+{
+    int i;
+
+    if (!fixture_boot()) {
+        return -1;
+    }
+    _size = savestate_size();
+    _now  = malloc(_size);
+    for (i = 0; i <= FRAMES; i++) {
+        _states[i] = malloc(_size);
+        if (!_states[i]) {
+            return -1;
+        }
+    }
+    return _now ? 0 : -1;
+}
+
+/* At READY with the program running from the keyboard buffer */
+int each_before()
+{
+    rewind_enable(false);
+    fixture_start_program();
+    rewind_set_period(1);
+    rewind_set_budget(REWIND_DEFAULT_BUDGET);
+    return 0;
+}
+
+static void keep(int frame)
+{
+    struct cpu_state state;
+
+    cpu_get_state(&state);
+    _instructions[frame] = state.instructions;
+    savestate_write(_states[frame]);
+}
+
+/* Runs with rewind on, keeping the state after each frame */
+static bool record()
+{
+    int i;
+
+    if (!rewind_enable(true)) {
+        printf("Out of memory\n");
+        return false;
+    }
+    keep(0);
+    for (i = 1; i <= FRAMES; i++) {
+        fixture_run(1);
+        keep(i);
+    }
+    return true;
+}
+
+static bool is_state_of(int frame)
+{
+    savestate_write(_now);
+    if (memcmp(_now, _states[frame], _size) != 0) {
+        printf("Not the state of frame %d\n", frame);
+        return false;
+    }
+    return true;
+}
+
+int test_back_to_recorded_frames()
+{
+    const int frames[] = { 95, 60, 59, 30, 1, 0 };
+    size_t    i;
+
+    if (!record()) {
+        return 0;
+    }
+    if (rewind_depth() != FRAMES) {
+        printf("Depth %u, expected %d\n", rewind_depth(), FRAMES);
+        return 0;
+    }
+    for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+        if (!rewind_back_to(_instructions[frames[i]], 0) ||
+            !is_state_of(frames[i])) {
+            return 0;
+        }
+    }
+    if (rewind_back() || rewind_depth() != 0) {
+        printf("Stepped back past the first snapshot\n");
+        return 0;
+    }
+    return 1;
+}
+
+int test_back_one_snapshot_at_a_time()
+{
+    int i;
+
+    if (!record()) {
+        return 0;
+    }
+    for (i = FRAMES - 1; i >= FRAMES - 10; i--) {
+        if (!rewind_back() || !is_state_of(i)) {
+            return 0;
+        }
+    }
+    /* Runs on from there as it did the first time */
+    for (i = FRAMES - 10 + 1; i <= FRAMES; i++) {
+        fixture_run(1);
+        if (!is_state_of(i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int test_budget_drops_oldest()
+{
+    uint64_t cycles;
+    uint32_t depth;
+    int      oldest;
+
+    /* The newest snapshot and room for the next, some deltas */
+    rewind_set_budget(2 * sizeof(struct c64_saved_state) + 16 * 1024);
+    if (!record()) {
+        return 0;
+    }
+    depth = rewind_depth();
+    if (depth == 0 || depth >= FRAMES) {
+        printf("Depth %u within budget\n", depth);
+        return 0;
+    }
+    oldest = FRAMES - depth;
+
+    /* Dropped, nothing changes */
+    cycles = c64_cycles();
+    if (rewind_back_to(_instructions[oldest - 1], 0) ||
+        c64_cycles() != cycles) {
+        printf("Stepped back to dropped frame %d\n", oldest - 1);
+        return 0;
+    }
+    if (!rewind_back_to(_instructions[oldest], 0) || !is_state_of(oldest)) {
+        return 0;
+    }
+    return rewind_depth() == 0;
+}
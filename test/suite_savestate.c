@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c64.h"
+#include "savestate.h"
+#include "machine_fixture.h"
+
+/* Saves and restores the whole machine, and feeds the reader states
+ * that are broken. The state file is kept in the build directory. */
+
+#ifndef C64_STATE_PATH
+#define C64_STATE_PATH "suite_savestate.state"
+#endif
+
+/* Where the fields are in a serialized state, see savestate.c */
+#define OFFSET_VERSION       4
+#define OFFSET_CHUNK         16
+#define OFFSET_CHUNK_VERSION (OFFSET_CHUNK + 4)
+#define OFFSET_CHUNK_SIZE    (OFFSET_CHUNK + 8)
+
+static const char *_path = C64_STATE_PATH;
+static uint8_t    *_buf;
+static size_t     _size;
+
+int once_before()
+{
+    if (!fixture_boot()) {
+        return -1;
+    }
+    _size = savestate_size();
+    _buf  = malloc(_size);
+    return _buf ? 0 : -1;
+}
+
+/* At READY with the program running from the keyboard buffer */
+int each_before()
+{
+    fixture_start_program();
+    remove(_path);
+    return 0;
+}
+
+static bool read_file(const char *path, uint8_t *buf, size_t size)
+{
+    FILE *f = fopen(path, "rb");
+    bool ok;
+
+    if (!f) {
+        return false;
+    }
+    /* Exactly size bytes */
+    ok = fread(buf, size, 1, f) == 1 && fgetc(f) == EOF;
+    fclose(f);
+    return ok;
+}
+
+int test_restored_state_runs_the_same()
+{
+    static uint8_t   ram[0x10000];
+    struct cpu_state cpu;
+    struct cpu_state cpu_again;
+    uint64_t         hash;
+    uint64_t         cycles;
+
+    fixture_run(20);
+    if (!savestate_save(_path)) {
+        printf("Failed to save %s\n", _path);
+        return 0;
+    }
+    fixture_run(50);
+    memcpy(ram, mem_get_ram(0), sizeof(ram));
+    cpu_get_state(&cpu);
+    hash   = c64_framebuffer_hash();
+    cycles = c64_cycles();
+
+    fixture_ready();
+    if (!savestate_restore(_path)) {
+        printf("Failed to restore %s\n", _path);
+        return 0;
+    }
+    fixture_run(50);
+    cpu_get_state(&cpu_again);
+    if (c64_cycles() != cycles ||
+        memcmp(ram, mem_get_ram(0), sizeof(ram)) != 0 ||
+        memcmp(&cpu, &cpu_again, sizeof(cpu)) != 0 ||
+        c64_framebuffer_hash() != hash) {
+        printf("Runs differ after restoring\n");
+        return 0;
+    }
+    if (*mem_get_ram(0x0400) == 0) {
+        printf("Program did not run\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Breaks a byte of a good state, the reader must refuse it and leave
+ * the machine as it is */
+static bool refused_with(size_t offset, uint32_t val)
+{
+    uint64_t cycles;
+
+    savestate_write(_buf);
+    memcpy(_buf + offset, &val, sizeof(val));
+    fixture_run(1);
+    cycles = c64_cycles();
+    if (savestate_read(_buf, _size) || c64_cycles() != cycles) {
+        printf("Accepted %u at %zu\n", val, offset);
+        return false;
+    }
+    return true;
+}
+
+int test_bad_header_or_chunk_is_refused()
+{
+    uint32_t magic;
+    uint32_t chunk_size;
+
+    memcpy(&magic, "XXXX", sizeof(magic));
+    savestate_write(_buf);
+    memcpy(&chunk_size, _buf + OFFSET_CHUNK_SIZE, sizeof(chunk_size));
+
+    return refused_with(0, magic) &&
+           refused_with(OFFSET_VERSION, SAVESTATE_VERSION + 1) &&
+           refused_with(OFFSET_CHUNK_VERSION, 0xffff) &&
+           refused_with(OFFSET_CHUNK_SIZE, chunk_size - 1) &&
+           refused_with(OFFSET_CHUNK_SIZE, chunk_size + 1) &&
+           refused_with(OFFSET_CHUNK_SIZE, 0xffffffff);
+}
+
+int test_truncated_state_is_refused()
+{
+    FILE   *f;
+    size_t sizes[] = { 0, 8, OFFSET_CHUNK + 4, _size / 2, _size - 1 };
+    size_t i;
+
+    savestate_write(_buf);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (savestate_read(_buf, sizes[i])) {
+            printf("Accepted %zu of %zu bytes\n", sizes[i], _size);
+            return 0;
+        }
+    }
+
+    f = fopen(_path, "wb");
+    if (!f || fwrite(_buf, _size - 1, 1, f) != 1 || fclose(f) != 0) {
+        printf("Failed to write %s\n", _path);
+        return 0;
+    }
+    if (savestate_restore(_path)) {
+        printf("Restored truncated file\n");
+        return 0;
+    }
+    return 1;
+}
+
+int test_failed_save_keeps_file()
+{
+    uint8_t *after = malloc(_size);
+    char    tmp[1024];
+    int     len;
+    bool    saved;
+    bool    kept;
+
+    if (!after || !savestate_save(_path) || !read_file(_path, _buf, _size)) {
+        printf("Failed to save %s\n", _path);
+        free(after);
+        return 0;
+    }
+    fixture_run(10);
+
+    /* Temporary file the state is written to cannot be written */
+    len = snprintf(tmp, sizeof(tmp), "%s.%d", _path, (int)getpid());
+    if (len < 0 || (size_t)len >= sizeof(tmp) ||
+        symlink("/dev/full", tmp) != 0) {
+        printf("Failed to link %s\n", tmp);
+        free(after);
+        return 0;
+    }
+    saved = savestate_save(_path);
+    kept  = read_file(_path, after, _size) &&
+            memcmp(_buf, after, _size) == 0;
+    free(after);
+    if (access(tmp, F_OK) == 0) {
+        printf("Temporary file left\n");
+        remove(tmp);
+        return 0;
+    }
+    if (saved || !kept) {
+        printf("Saved to a full device, or file changed\n");
+        return 0;
+    }
+    return 1;
+}
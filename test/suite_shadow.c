@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c64.h"
+#include "input.h"
+#include "machine_fixture.h"
+
+/* Runs the whole machine with shadow execution, fast paths and the
+ * reference stepping every instruction must agree. */
+
+/* At READY with the program running from the keyboard buffer */
+static bool start()
+{
+    if (!fixture_boot()) {
+        return false;
+    }
+    fixture_start_program();
+    return c64_set_shadow(true);
+}
+
+static void run(uint64_t frames)
+{
+    uint64_t end = c64_frames() + frames;
+
+    while (c64_frames() < end && !c64_shadow_differs()) {
+        c64_step();
+    }
+}
+
+static uint8_t *wrong_page(uint8_t page, bool write)
+{
+    static uint8_t elsewhere[256];
+
+    return page == 0x20 && write ? elsewhere :
+                                   mem_get_page_for_cpu(page, write);
+}
+
+int test_fast_paths_agree_with_every_step()
+{
+    if (!start()) {
+        return 0;
+    }
+    run(50);
+    input_key_down(KEYB_SPACE);
+    run(10);
+    input_key_up(KEYB_SPACE);
+    run(50);
+    if (c64_shadow_differs() || !c64_is_shadow()) {
+        printf("Expected no difference\n");
+        return 0;
+    }
+    if (*mem_get_ram(0x2000) == 0 && *mem_get_ram(0x0400) == 0) {
+        printf("Program did not run\n");
+        return 0;
+    }
+    c64_set_shadow(false);
+    return 1;
+}
+
+int test_broken_loop_acceleration_is_found()
+{
+    uint64_t end;
+
+    if (!start()) {
+        return 0;
+    }
+    /* Put back after every frame executed again */
+    end = c64_frames() + 100;
+    while (c64_frames() < end && c64_is_shadow()) {
+        cpu_set_loop_acceleration(wrong_page);
+        c64_step();
+    }
+    if (!c64_shadow_differs() || c64_is_shadow()) {
+        printf("Expected a difference to stop shadow execution\n");
+        return 0;
+    }
+    c64_set_loop_acceleration(true);
+    return 1;
+}
@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "trap.h"
+
+/* Runs KERNAL routines from the ROM code below with and without
+ * their trap and expects the same outcome. */
+
+#define RAM_SIZE 65536
+#define CALLER   0x1000
+
+static uint8_t _ram[RAM_SIZE];
+static uint8_t _ram_before[RAM_SIZE];
+static uint8_t _ram_rom[RAM_SIZE];
+static bool    _kernal_mapped;
+
+static const uint8_t _ramtas[] = {
+    /* $fd50 - $fd9a */
+    0xa9, 0x00, 0xa8, 0x99, 0x02, 0x00, 0x99, 0x00,
+    0x02, 0x99, 0x00, 0x03, 0xc8, 0xd0, 0xf4, 0xa2,
+    0x3c, 0xa0, 0x03, 0x86, 0xb2, 0x84, 0xb3, 0xa8,
+    0xa9, 0x03, 0x85, 0xc2, 0xe6, 0xc2, 0xb1, 0xc1,
+    0xaa, 0xa9, 0x55, 0x91, 0xc1, 0xd1, 0xc1, 0xd0,
+    0x0f, 0x2a, 0x91, 0xc1, 0xd1, 0xc1, 0xd0, 0x08,
+    0x8a, 0x91, 0xc1, 0xc8, 0xd0, 0xe8, 0xf0, 0xe4,
+    0x98, 0xaa, 0xa4, 0xc2, 0x18, 0x20, 0x2d, 0xfe,
+    0xa9, 0x08, 0x8d, 0x82, 0x02, 0xa9, 0x04, 0x8d,
+    0x88, 0x02, 0x60,
+};
+static const uint8_t _memtop[] = {
+    /* $fe2d - $fe33 */
+    0x8e, 0x83, 0x02, 0x8c, 0x84, 0x02, 0x60,
+};
+static const uint8_t _screen_lines[] = {
+    /* $e9c8 - $ea11 */
+    0x29, 0x03, 0x0d, 0x88, 0x02, 0x85, 0xad, 0x20,
+    0xe0, 0xe9, 0xa0, 0x27, 0xb1, 0xac, 0x91, 0xd1,
+    0xb1, 0xae, 0x91, 0xf3, 0x88, 0x10, 0xf5, 0x60,
+    0x20, 0x24, 0xea, 0xa5, 0xac, 0x85, 0xae, 0xa5,
+    0xad, 0x29, 0x03, 0x09, 0xd8, 0x85, 0xaf, 0x60,
+    0xbd, 0xf0, 0xec, 0x85, 0xd1, 0xb5, 0xd9, 0x29,
+    0x03, 0x0d, 0x88, 0x02, 0x85, 0xd2, 0x60, 0xa0,
+    0x27, 0x20, 0xf0, 0xe9, 0x20, 0x24, 0xea, 0x20,
+    0xda, 0xe4, 0xa9, 0x20, 0x91, 0xd1, 0x88, 0x10,
+    0xf6, 0x60,
+};
+static const uint8_t _color_pointer[] = {
+    /* $ea24 - $ea30 */
+    0xa5, 0xd1, 0x85, 0xf3, 0xa5, 0xd2, 0x29, 0x03,
+    0x09, 0xd8, 0x85, 0xf4, 0x60,
+};
+static const uint8_t _set_color[] = {
+    /* $e4da - $e4df */
+    0xad, 0x86, 0x02, 0x91, 0xf3, 0x60,
+};
+static const uint8_t _line_addresses[] = {
+    /* $ecf0 - $ed08 */
+    0x00, 0x28, 0x50, 0x78, 0xa0, 0xc8, 0xf0, 0x18,
+    0x40, 0x68, 0x90, 0xb8, 0xe0, 0x08, 0x30, 0x58,
+    0x80, 0xa8, 0xd0, 0xf8, 0x20, 0x48, 0x70, 0x98,
+    0xc0,
+};
+
+/* Mock memory, BASIC and KERNAL areas are read only */
+uint8_t mem_get_for_cpu(uint16_t addr)
+{
+    return _ram[addr];
+}
+
+void mem_set_for_cpu(uint16_t addr, uint8_t val)
+{
+    if ((addr >= 0xa000 && addr < 0xc000) || addr >= 0xe000) {
+        return;
+    }
+    _ram[addr] = val;
+}
+
+bool pla_is_kernal_mapped()
+{
+    return _kernal_mapped;
+}
+
+bool pla_is_basic_mapped()
+{
+    return true;
+}
+
+/* Calls routine from a JSR and counts executed instructions until
+ * it has returned. */
+static int call(uint16_t routine, struct cpu_state *state)
+{
+    int executed = 0;
+
+    _ram[CALLER]     = 0x20;
+    _ram[CALLER + 1] = routine & 0xff;
+    _ram[CALLER + 2] = routine >> 8;
+    state->pc = CALLER;
+    cpu_set_state(state);
+    do {
+        executed += cpu_step(state);
+    } while (state->pc != CALLER + 3 && executed < 1000000);
+    return executed;
+}
+
+/* Same result from ROM code and trap */
+static bool compare(uint16_t routine, struct cpu_state *state)
+{
+    struct cpu_state state_rom = *state;
+    int              executed_rom;
+    int              executed;
+
+    memcpy(_ram_before, _ram, RAM_SIZE);
+    trap_enable("all", false);
+    executed_rom = call(routine, &state_rom);
+    memcpy(_ram_rom, _ram, RAM_SIZE);
+
+    memcpy(_ram, _ram_before, RAM_SIZE);
+    trap_enable("all", true);
+    executed = call(routine, state);
+
+    if (executed != executed_rom) {
+        printf("Executed %d instructions, ROM %d\n",
+               executed, executed_rom);
+        return false;
+    }
+    if (memcmp(state, &state_rom, sizeof(*state)) != 0) {
+        printf("A %02x/%02x X %02x/%02x Y %02x/%02x "
+               "P %02x/%02x S %02x/%02x\n",
+               state->reg_a, state_rom.reg_a,
+               state->reg_x, state_rom.reg_x,
+               state->reg_y, state_rom.reg_y,
+               state->flags, state_rom.flags,
+               state->sp, state_rom.sp);
+        return false;
+    }
+    for (int i = 0; i < RAM_SIZE; i++) {
+        if (_ram[i] != _ram_rom[i]) {
+            printf("At %04x %02x, ROM %02x\n", i, _ram[i], _ram_rom[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int once_before()
+{
+    cpu_init(mem_get_for_cpu, mem_set_for_cpu);
+    trap_init();
+    return 0;
+}
+
+int each_before()
+{
+    memset(_ram, 0, RAM_SIZE);
+    memcpy(_ram + 0xfd50, _ramtas, sizeof(_ramtas));
+    memcpy(_ram + 0xfe2d, _memtop, sizeof(_memtop));
+    memcpy(_ram + 0xe9c8, _screen_lines, sizeof(_screen_lines));
+    memcpy(_ram + 0xea24, _color_pointer, sizeof(_color_pointer));
+    memcpy(_ram + 0xe4da, _set_color, sizeof(_set_color));
+    memcpy(_ram + 0xecf0, _line_addresses, sizeof(_line_addresses));
+    _kernal_mapped = true;
+    cpu_reset();
+    trap_enable("all", true);
+    return 0;
+}
+
+static void fill_screen()
+{
+    for (int i = 0; i < 1000; i++) {
+        _ram[0x0400 + i] = i * 7;
+        _ram[0xd800 + i] = i & 0x0f;
+    }
+    /* Line link table, all lines start a logical line */
+    for (int i = 0; i < 26; i++) {
+        _ram[0xd9 + i] = 0x84 + (i * 40) / 256;
+    }
+    _ram[0x0286] = 0x0e;
+    _ram[0x0288] = 0x04;
+}
+
+int test_ramtas()
+{
+    struct cpu_state state = { .sp = 0xfb, .flags = FLAG_IRQ_DISABLE };
+
+    /* Leftovers that must survive the memory test */
+    for (int i = 0x0400; i < 0xa000; i += 3) {
+        _ram[i] = i >> 4;
+    }
+    if (!compare(0xfd50, &state)) {
+        return 0;
+    }
+    /* Top of memory at start of BASIC ROM */
+    return _ram[0x0283] == 0x00 && _ram[0x0284] == 0xa0;
+}
+
+int test_clear_line()
+{
+    struct cpu_state state = { .sp = 0xf0, .reg_x = 0x11,
+                               .flags = FLAG_CARRY | FLAG_OVERFLOW };
+
+    fill_screen();
+    return compare(0xe9ff, &state);
+}
+
+int test_move_line()
+{
+    struct cpu_state state = { .sp = 0xe2, .reg_x = 0x03,
+                               .reg_a = 0x84, .flags = FLAG_CARRY };
+
+    fill_screen();
+    /* From line 4 to line 3 */
+    _ram[0xac] = 0xa0;
+    _ram[0xd1] = 0x78;
+    _ram[0xd2] = 0x04;
+    return compare(0xe9c8, &state);
+}
+
+int test_not_taken_when_unmapped()
+{
+    struct cpu_state state = { .sp = 0xf0, .reg_x = 0x02 };
+    int              steps = 0;
+
+    fill_screen();
+    _kernal_mapped = false;
+    _ram[CALLER]     = 0x20;
+    _ram[CALLER + 1] = 0xff;
+    _ram[CALLER + 2] = 0xe9;
+    state.pc = CALLER;
+    cpu_set_state(&state);
+    do {
+        if (cpu_step(&state) != 1) {
+            return 0;
+        }
+        steps++;
+    } while (state.pc != CALLER + 3);
+
+    /* JSR and every instruction of the routine */
+    return steps == 1 + 338;
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+
+/* Converts a binary file to a C array, used for linking ROM images
+ * into the executable.
+ *
+ * Usage: bin2c <input> <output> <name>
+ */
+
+int main(int argc, char **argv)
+{
+    FILE *in;
+    FILE *out;
+    int  c;
+    long size = 0;
+
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <input> <output> <name>\n", argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "Failed to create %s\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    fprintf(out, "/* Generated from %s, do not edit */\n", argv[1]);
+    fprintf(out, "#include <stdint.h>\n\n");
+    fprintf(out, "const uint8_t %s[] = {", argv[3]);
+    while ((c = fgetc(in)) != EOF) {
+        if (size % 12 == 0) {
+            fprintf(out, "\n   ");
+        }
+        fprintf(out, " 0x%02x,", c);
+        size++;
+    }
+    fprintf(out, "\n};\n");
+
+    fclose(in);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "trace.h"
+
+/* Turns a binary trace into the text the trace points write.
+ *
+ * Usage: trace_decode [-c] <trace>
+ *   -c  Prefix every line with the cycle it was recorded at
+ */
+
+#define MAX_POINTS 1024
+
+struct point_name {
+    char sys[TRACE_PAYLOAD_SIZE + 1];
+    char name[TRACE_PAYLOAD_SIZE + 1];
+};
+
+static struct point_name _points[MAX_POINTS];
+
+static void add_point(const struct trace_record *record)
+{
+    struct point_name *point;
+    size_t            len;
+
+    if (record->point >= MAX_POINTS) {
+        return;
+    }
+    point = &_points[record->point];
+    len   = strnlen((const char*)record->payload, TRACE_PAYLOAD_SIZE);
+    memcpy(point->sys, record->payload, len);
+    point->sys[len] = 0;
+    if (len + 1 < TRACE_PAYLOAD_SIZE) {
+        snprintf(point->name, sizeof(point->name), "%.*s",
+                 (int)(TRACE_PAYLOAD_SIZE - len - 1),
+                 record->payload + len + 1);
+    }
+}
+
+static void print_text(const struct trace_record *record)
+{
+    const char *sys  = "?";
+    const char *name = "?";
+
+    if (record->point < MAX_POINTS && _points[record->point].sys[0]) {
+        sys  = _points[record->point].sys;
+        name = _points[record->point].name;
+    }
+    printf("%s %s: %.*s\n", sys, name, record->size, record->payload);
+}
+
+static void print_execution(const struct trace_record *record)
+{
+    const struct trace_execution *execution =
+        (const struct trace_execution*)record->payload;
+    struct cpu_state             before = {
+        .pc    = record->pc,
+        .reg_a = record->reg_a,
+        .reg_x = record->reg_x,
+        .reg_y = record->reg_y,
+        .flags = record->flags,
+        .sp    = record->sp,
+    };
+    struct cpu_state             after = {
+        .reg_a = execution->reg_a,
+        .reg_x = execution->reg_x,
+        .reg_y = execution->reg_y,
+        .flags = execution->flags,
+        .sp    = execution->sp,
+    };
+    char                         line[80];
+
+    cpu_trace_line(line, sizeof(line), execution->bytes, &before, &after);
+    fputs(line, stdout);
+}
+
+int main(int argc, char **argv)
+{
+    struct trace_file_header header;
+    struct trace_record      record;
+    FILE                     *in;
+    bool                     cycles = false;
+    int                      opt;
+
+    while ((opt = getopt(argc, argv, "c")) != -1) {
+        switch (opt) {
+        case 'c':
+            cycles = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-c] <trace>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-c] <trace>\n", argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[optind], "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", argv[optind]);
+        return 1;
+    }
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, TRACE_FILE_MAGIC, 4) != 0 ||
+        header.version != TRACE_FILE_VERSION ||
+        header.record_size != sizeof(record)) {
+        fprintf(stderr, "%s is not a trace of this version\n",
+                argv[optind]);
+        fclose(in);
+        return 1;
+    }
+
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (record.kind == trace_record_point) {
+            add_point(&record);
+            continue;
+        }
+        if (cycles) {
+            printf("%10llu ", (unsigned long long)record.cycle);
+        }
+        switch (record.kind) {
+        case trace_record_text:
+            print_text(&record);
+            break;
+        case trace_record_execution:
+            print_execution(&record);
+            break;
+        default:
+            printf("Unknown record %d\n", record.kind);
+            break;
+        }
+    }
+
+    fclose(in);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "c64.h"
+#include "cpu.h"
+#include "mem.h"
+#include "vic.h"
+#include "boot.h"
+#include "speed.h"
+#include "trace.h"
+#include "perf.h"
+#include "metrics.h"
+#include "input.h"
+#include "trap.h"
+#include "headless_c64.h"
+
+static const struct headless_options *_options;
+static bool _done;
+
+static void on_refresh()
+{
+    speed_frame(c64_cycles());
+    if (_options->frames && c64_frames() >= _options->frames) {
+        _done = true;
+    }
+}
+
+static void load_prg()
+{
+    uint16_t start;
+    uint16_t size;
+
+    if (input_load_prg(_options->prg, &start, &size) != 0) {
+        printf("Failed to load %s\n", _options->prg);
+        return;
+    }
+    printf("Loaded %04x bytes program starts at %04x\n", size, start);
+}
+
+static bool dump_ram(const char *path)
+{
+    FILE   *f = fopen(path, "wb");
+    size_t written;
+
+    if (!f) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    written = fwrite(mem_get_ram(0), 1, 0x10000, f);
+    fclose(f);
+    return written == 0x10000;
+}
+
+static bool write_stats(const char *path, uint16_t pc)
+{
+    struct speed_stats stats;
+    FILE               *f = stdout;
+
+    if (path) {
+        f = fopen(path, "w");
+        if (!f) {
+            printf("Failed to open %s\n", path);
+            return false;
+        }
+    }
+
+    speed_get_total(&stats);
+    fprintf(f, "frames %llu\n", (unsigned long long)c64_frames());
+    fprintf(f, "cycles %llu\n", (unsigned long long)c64_cycles());
+    fprintf(f, "pc %04x\n", pc);
+    fprintf(f, "mhz %.3f\n", stats.mhz);
+    fprintf(f, "fps %.1f\n", stats.fps);
+    fprintf(f, "percent %.0f\n", stats.percent);
+    fprintf(f, "frame_min_ms %.3f\n", stats.frame_min_ms);
+    fprintf(f, "frame_avg_ms %.3f\n", stats.frame_avg_ms);
+    fprintf(f, "frame_max_ms %.3f\n", stats.frame_max_ms);
+
+    if (path) {
+        fclose(f);
+    }
+    return true;
+}
+
+int headless_c64_run(const struct headless_options *options,
+                     struct headless_results *results)
+{
+    struct cpu_state state;
+    bool             prg_pending = options->prg != NULL;
+    bool             ok          = true;
+
+    _options = options;
+    _done    = false;
+
+    c64_screen_default();
+    c64_set_refresh_hook(on_refresh);
+    speed_set_warp(true);
+    speed_reset();
+
+    /* Stop conditions are checked between steps, a skipped idle loop
+     * or an accelerated copy loop would run past them. */
+    if (options->cycles || options->break_on_pc) {
+        c64_set_idle_skip(false);
+        c64_set_loop_acceleration(false);
+    }
+    if (options->exact) {
+        trap_set_acceleration(false);
+    }
+    /* Every instruction is traced when it is executed */
+    if (options->trace) {
+        if (!trace_binary_open(options->trace)) {
+            printf("Failed to open %s\n", options->trace);
+            return -1;
+        }
+        trace_enable_point("CPU", "execution", TRACE_FD_BINARY);
+        c64_set_idle_skip(false);
+        c64_set_loop_acceleration(false);
+    }
+
+    if (options->shadow && !c64_set_shadow(true)) {
+        printf("Out of memory\n");
+        return -1;
+    }
+
+    if (options->perf_dump) {
+        if (!perf_set_dump(options->perf_dump, 1)) {
+            printf("Failed to open %s\n", options->perf_dump);
+            return -1;
+        }
+        perf_enable(true);
+    }
+    if (options->metrics_dump) {
+        if (!metrics_set_dump(options->metrics_dump,
+                              options->metrics_period)) {
+            printf("Failed to open %s\n", options->metrics_dump);
+            return -1;
+        }
+    }
+
+    if (options->replay) {
+        if (!input_replay(options->replay)) {
+            printf("Failed to replay %s\n", options->replay);
+            return -1;
+        }
+        prg_pending = false;
+    }
+    else if (options->boot_cache) {
+        if (boot_to_ready(options->boot_cache) != 0) {
+            return -1;
+        }
+        if (prg_pending) {
+            prg_pending = false;
+            load_prg();
+        }
+    }
+
+    while (!_done) {
+        c64_step();
+
+        cpu_get_state(&state);
+        if (prg_pending && state.pc == BOOT_READY_PC) {
+            prg_pending = false;
+            load_prg();
+        }
+        if (options->break_on_pc && state.pc == options->break_pc) {
+            _done = true;
+        }
+        if (options->cycles && c64_cycles() >= options->cycles) {
+            _done = true;
+        }
+        if (options->replay && !input_is_replaying()) {
+            _done = true;
+        }
+        if (options->shadow && c64_shadow_differs()) {
+            _done = true;
+            ok    = false;
+        }
+    }
+    c64_set_refresh_hook(NULL);
+    if (options->shadow) {
+        c64_set_shadow(false);
+    }
+    if (options->replay) {
+        input_stop();
+    }
+    if (options->trace) {
+        trace_binary_close();
+    }
+    if (options->perf_dump) {
+        perf_enable(false);
+        perf_set_dump(NULL, 0);
+    }
+    if (options->metrics_dump) {
+        metrics_set_dump(NULL, 0);
+    }
+
+    if (options->screenshot) {
+        vic_snapshot(options->screenshot);
+    }
+    if (options->ram_dump) {
+        ok = dump_ram(options->ram_dump) && ok;
+    }
+    if (results) {
+        results->frames       = c64_frames();
+        results->cycles       = c64_cycles();
+        results->instructions = state.instructions;
+        results->pc           = state.pc;
+        speed_get_total(&results->speed);
+    }
+    if (options->stats || !results) {
+        ok = write_stats(options->stats, state.pc) && ok;
+    }
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "speed.h"
+
+/* Runs the machine without any display or input, for batch use. */
+
+struct headless_options {
+    /* PRG to load when BASIC is ready for input */
+    const char *prg;
+    /* State at READY is cached here, NULL to always cold boot */
+    const char *boot_cache;
+    /* Input log replayed instead of booting and loading the PRG. Its
+     * idle skipping, loop and trap acceleration are used, stop
+     * conditions are checked where its steps end. Stops at its end
+     * as well. */
+    const char *replay;
+
+    /* Stops at whatever comes first, 0 when not used */
+    uint64_t frames;
+    uint64_t cycles;
+    bool     break_on_pc;
+    uint16_t break_pc;
+    /* Stops exactly at frames and cycles, ROM routines are executed
+     * instead of trapped, see trap_set_acceleration(). Otherwise a
+     * trapped routine like RAMTAS may run past them, the results tell
+     * where the run stopped. */
+    bool     exact;
+    /* Validates idle skipping and loop acceleration every frame, see
+     * c64_set_shadow(). The run stops and fails on a difference. */
+    bool     shadow;
+
+    /* Results, not written when NULL */
+    const char *screenshot;
+    const char *ram_dump;
+    /* Timing statistics, stdout when NULL */
+    const char *stats;
+    /* Binary trace of every executed instruction, NULL for none */
+    const char *trace;
+    /* Host time per subsystem as a JSON line per frame, NULL for none */
+    const char *perf_dump;
+    /* Device counters as a JSON line every metrics_period frames,
+     * NULL for none */
+    const char *metrics_dump;
+    uint32_t   metrics_period;
+};
+
+/* How a run ended */
+struct headless_results {
+    uint64_t           frames;
+    uint64_t           cycles;
+    uint64_t           instructions;
+    uint16_t           pc;
+    struct speed_stats speed;
+};
+
+/* Results are filled in when not NULL, timing statistics are then
+ * only written when options name a file for them. */
+int headless_c64_run(const struct headless_options *options,
+                     struct headless_results *results);
@@ -7,6 +7,7 @@
 
 #include "petscii.h"
 #include "keyboard.h"
+#include "input.h"
 #include "cpu.h"
 #include "cia1.h"
 #include "mem.h"
@@ -266,18 +267,18 @@ void ncurses_c64_loop(struct cpu_state *state)
             key = map_key(ch, &extra_key);
             if (key) {
                 num_key_downs = 19000;
-                keyboard_down(key);
+                input_key_down(key);
                 if (extra_key) {
-                    keyboard_down(extra_key);
+                    input_key_down(extra_key);
                 }
             }
         }
         else {
             num_key_downs--;
             if (num_key_downs == 0 && key) {
-                keyboard_up(key);
+                input_key_up(key);
                 if (extra_key) {
-                    keyboard_up(extra_key);
+                    input_key_up(extra_key);
                 }
             }
         }
@@ -1,13 +1,16 @@
-#include <time.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include <SDL.h>
 
 #include "c64.h"
 #include "vic.h"
 #include "keyboard.h"
+#include "speed.h"
+#include "metrics.h"
+#include "input.h"
 
-static struct timespec _start, _stop;
 static struct SDL_Window *_window;
+static uint64_t          _title_frame;
 
 static uint16_t map_key(SDL_Keycode sym)
 {
@@ -186,12 +189,31 @@ static uint16_t map_key(SDL_Keycode sym)
     return 0;
 }
 
+static void update_title()
+{
+    char title[100];
+    int  len;
+
+    len = snprintf(title, sizeof(title), "Commodore C64 - ");
+    speed_describe(title + len, sizeof(title) - len);
+    SDL_SetWindowTitle(_window, title);
+}
+
 static void do_refresh()
 {
-    clock_gettime(CLOCK_MONOTONIC, &_stop);
-    SDL_UpdateWindowSurface(_window);
-    //printf("Num ms %ld\n", (_stop.tv_nsec - start.tv_nsec)/1000000);
-    clock_gettime(CLOCK_MONOTONIC, &_start);
+    speed_frame(c64_cycles());
+    if (speed_should_present()) {
+        SDL_UpdateWindowSurface(_window);
+    }
+    else {
+        metrics.frames_skipped++;
+    }
+    /* Refresh readout about once a second of emulated time */
+    if (c64_frames() - _title_frame >= 50) {
+        _title_frame = c64_frames();
+        update_title();
+    }
+    speed_throttle();
 }
 
 void sdl_c64_loop()
@@ -217,11 +239,13 @@ void sdl_c64_loop()
     }
 
     vic_screen(surface->pixels, surface->pitch);
-    vic_set_refresh_hook(do_refresh);
+    c64_set_refresh_hook(do_refresh);
 
     uint16_t key;
+    bool     differed = c64_shadow_differs();
 
-    clock_gettime(CLOCK_MONOTONIC, &_start);
+    speed_reset();
+    _title_frame = c64_frames();
     while (!end) {
         if (SDL_PollEvent(&event)) {
             switch (event.type) {
@@ -233,10 +257,21 @@ void sdl_c64_loop()
                 case SDLK_ESCAPE:
                     end = true;
                     break;
+                case SDLK_F11:
+                    /* Held down the key repeats. Emulated time went
+                     * backwards, speed is measured from here. */
+                    if (input_rewind_back()) {
+                        speed_reset();
+                    }
+                    break;
+                case SDLK_F12:
+                    speed_set_warp(!speed_is_warp());
+                    update_title();
+                    break;
                 default:
                     key = map_key(event.key.keysym.sym);
                     if (key) {
-                        keyboard_down(key);
+                        input_key_down(key);
                     }
                 }
                 break;
@@ -245,7 +280,7 @@ void sdl_c64_loop()
                 default:
                     key = map_key(event.key.keysym.sym);
                     if (key) {
-                        keyboard_up(key);
+                        input_key_up(key);
                     }
                 }
                 break;
@@ -253,8 +288,14 @@ void sdl_c64_loop()
         }
 
         c64_step();
+        /* Stopped before the step that differs, on to the monitor */
+        if (c64_shadow_differs() && !differed) {
+            end = true;
+        }
     }
     vic_snapshot("./snap.png");
+    c64_set_refresh_hook(NULL);
+    c64_screen_default();
 
     SDL_DestroyWindow(_window);
     SDL_Quit();